@@ -1,13 +1,113 @@
 #include "context.h"
 #include <assert.h>
 #include <sched.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 static __thread context_t* cur;
 
+#ifdef USE_STACK_SWITCH
+#define CONTEXT_STACK_SIZE (64*1024)
+
+#ifdef __APPLE__
+# define CONTEXT_SYM(x) "_" #x
+#else
+# define CONTEXT_SYM(x) #x
+#endif
+
+// Push the callee-saved registers and the FP control state onto the current
+// stack, store the stack pointer to *save_sp, and pop the same frame off
+// new_sp.  A fresh stack is seeded with a frame whose return address is
+// context_stack_start, which calls entry(ctx) from the saved registers.
+extern "C" void context_stack_switch(void** save_sp, void* new_sp);
+extern "C" void context_stack_start();
+
+#if defined(__x86_64__)
+#if defined(__CET__)
+# define CONTEXT_ENDBR "  endbr64\n"
+#else
+# define CONTEXT_ENDBR
+#endif
+// frame: mxcsr/fpcw, r15, r14, r13, r12 (entry), rbx (ctx), rbp, return
+#define CONTEXT_FRAME_WORDS 8
+asm(".text\n"
+    ".p2align 4\n"
+    CONTEXT_SYM(context_stack_switch) ":\n"
+    CONTEXT_ENDBR
+    "  pushq %rbp\n"
+    "  pushq %rbx\n"
+    "  pushq %r12\n"
+    "  pushq %r13\n"
+    "  pushq %r14\n"
+    "  pushq %r15\n"
+    "  subq $8, %rsp\n"
+    "  stmxcsr (%rsp)\n"
+    "  fnstcw 4(%rsp)\n"
+    "  movq %rsp, (%rdi)\n"
+    "  movq %rsi, %rsp\n"
+    "  ldmxcsr (%rsp)\n"
+    "  fldcw 4(%rsp)\n"
+    "  addq $8, %rsp\n"
+    "  popq %r15\n"
+    "  popq %r14\n"
+    "  popq %r13\n"
+    "  popq %r12\n"
+    "  popq %rbx\n"
+    "  popq %rbp\n"
+    "  ret\n"
+    CONTEXT_SYM(context_stack_start) ":\n"
+    CONTEXT_ENDBR
+    "  movq %rbx, %rdi\n"
+    "  callq *%r12\n"
+    "  ud2\n");
+#elif defined(__aarch64__)
+// frame: x19 (ctx), x20 (entry), x21-x28, x29, x30 (return), d8-d15, fpcr
+#define CONTEXT_FRAME_WORDS 22
+asm(".text\n"
+    ".p2align 4\n"
+    CONTEXT_SYM(context_stack_switch) ":\n"
+    "  sub sp, sp, #176\n"
+    "  stp x19, x20, [sp, #0]\n"
+    "  stp x21, x22, [sp, #16]\n"
+    "  stp x23, x24, [sp, #32]\n"
+    "  stp x25, x26, [sp, #48]\n"
+    "  stp x27, x28, [sp, #64]\n"
+    "  stp x29, x30, [sp, #80]\n"
+    "  stp d8, d9, [sp, #96]\n"
+    "  stp d10, d11, [sp, #112]\n"
+    "  stp d12, d13, [sp, #128]\n"
+    "  stp d14, d15, [sp, #144]\n"
+    "  mrs x2, fpcr\n"
+    "  str x2, [sp, #160]\n"
+    "  mov x2, sp\n"
+    "  str x2, [x0]\n"
+    "  mov sp, x1\n"
+    "  ldr x2, [sp, #160]\n"
+    "  msr fpcr, x2\n"
+    "  ldp x19, x20, [sp, #0]\n"
+    "  ldp x21, x22, [sp, #16]\n"
+    "  ldp x23, x24, [sp, #32]\n"
+    "  ldp x25, x26, [sp, #48]\n"
+    "  ldp x27, x28, [sp, #64]\n"
+    "  ldp x29, x30, [sp, #80]\n"
+    "  ldp d8, d9, [sp, #96]\n"
+    "  ldp d10, d11, [sp, #112]\n"
+    "  ldp d12, d13, [sp, #128]\n"
+    "  ldp d14, d15, [sp, #144]\n"
+    "  add sp, sp, #176\n"
+    "  ret\n"
+    CONTEXT_SYM(context_stack_start) ":\n"
+    "  mov x0, x19\n"
+    "  blr x20\n"
+    "  brk #0\n");
+#endif
+#endif
+
 context_t::context_t()
   : creator(NULL), func(NULL), arg(NULL),
-#ifndef USE_UCONTEXT
+#if defined(USE_STACK_SWITCH)
+    sp(NULL)
+#elif !defined(USE_UCONTEXT)
     mutex(PTHREAD_MUTEX_INITIALIZER),
     cond(PTHREAD_COND_INITIALIZER), flag(0)
 #else
@@ -16,7 +116,16 @@ context_t::context_t()
 {
 }
 
-#ifdef USE_UCONTEXT
+#if defined(USE_STACK_SWITCH)
+void context_t::wrapper(context_t* ctx)
+{
+  ctx->creator->switch_to();
+  ctx->func(ctx->arg);
+  // like uc_link, resume the creator if func ever returns
+  ctx->creator->switch_to();
+  abort();
+}
+#elif defined(USE_UCONTEXT)
 #ifndef GLIBC_64BIT_PTR_BUG
 void context_t::wrapper(context_t* ctx)
 {
@@ -46,7 +155,32 @@ void context_t::init(void (*f)(void*), void* a)
   arg = a;
   creator = current();
 
-#ifdef USE_UCONTEXT
+#if defined(USE_STACK_SWITCH)
+  stack.reset(new char[CONTEXT_STACK_SIZE]);
+  uintptr_t top = reinterpret_cast<uintptr_t>(stack.get()) + CONTEXT_STACK_SIZE;
+  uint64_t* frame = reinterpret_cast<uint64_t*>(top & ~uintptr_t(15)) - CONTEXT_FRAME_WORDS;
+  for (int i = 0; i < CONTEXT_FRAME_WORDS; i++)
+    frame[i] = 0;
+  void (*entry)(context_t*) = &context_t::wrapper;
+#if defined(__x86_64__)
+  uint32_t mxcsr;
+  uint16_t fpcw;
+  asm volatile ("stmxcsr %0\n\tfnstcw %1" : "=m"(mxcsr), "=m"(fpcw));
+  frame[0] = mxcsr | (uint64_t(fpcw) << 32);
+  frame[4] = reinterpret_cast<uint64_t>(entry);
+  frame[5] = reinterpret_cast<uint64_t>(this);
+  frame[7] = reinterpret_cast<uint64_t>(&context_stack_start);
+#elif defined(__aarch64__)
+  uint64_t fpcr;
+  asm volatile ("mrs %0, fpcr" : "=r"(fpcr));
+  frame[0] = reinterpret_cast<uint64_t>(this);
+  frame[1] = reinterpret_cast<uint64_t>(entry);
+  frame[11] = reinterpret_cast<uint64_t>(&context_stack_start);
+  frame[20] = fpcr;
+#endif
+  sp = frame;
+  switch_to();
+#elif defined(USE_UCONTEXT)
   getcontext(context.get());
   context->uc_link = creator->context.get();
   context->uc_stack.ss_size = 64*1024;
@@ -81,7 +215,11 @@ context_t::~context_t()
 void context_t::switch_to()
 {
   assert(this != cur);
-#ifdef USE_UCONTEXT
+#if defined(USE_STACK_SWITCH)
+  context_t* prev = cur;
+  cur = this;
+  context_stack_switch(&prev->sp, sp);
+#elif defined(USE_UCONTEXT)
   context_t* prev = cur;
   cur = this;
   if (swapcontext(prev->context.get(), context.get()) != 0)
@@ -104,7 +242,9 @@ context_t* context_t::current()
   if (cur == NULL)
   {
     cur = new context_t;
-#ifdef USE_UCONTEXT
+#if defined(USE_STACK_SWITCH)
+    // sp is filled in by the first switch away from this context
+#elif defined(USE_UCONTEXT)
     getcontext(cur->context.get());
 #else
     cur->thread = pthread_self();
@@ -5,7 +5,15 @@
 
 #include <pthread.h>
 
-#if defined(__GLIBC__)
+#if (defined(__x86_64__) && !(defined(__CET__) && (__CET__ & 2))) || \
+    defined(__aarch64__)
+// Switch stacks with a few instructions that save only the callee-saved
+// registers; swapcontext also does a sigprocmask syscall on every switch.
+// CET shadow stacks would reject the returns across stacks, so builds with
+// -fcf-protection=return or =full keep using swapcontext.
+# define USE_STACK_SWITCH
+# include <memory>
+#elif defined(__GLIBC__)
 # undef USE_UCONTEXT
 # define USE_UCONTEXT
 # include <ucontext.h>
@@ -35,7 +43,11 @@ class context_t
   context_t* creator;
   void (*func)(void*);
   void* arg;
-#ifdef USE_UCONTEXT
+#if defined(USE_STACK_SWITCH)
+  std::unique_ptr<char[]> stack;
+  void* sp;
+  static void wrapper(context_t*);
+#elif defined(USE_UCONTEXT)
   std::unique_ptr<ucontext_t> context;
 #ifndef GLIBC_64BIT_PTR_BUG
   static void wrapper(context_t*);
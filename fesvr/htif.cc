@@ -115,6 +115,18 @@ std::map<std::string, uint64_t> htif_t::load_payload(const std::string& payload,
         memif_t::write(taddr, len, src);
     }
 
+    void clear(addr_t taddr, size_t len) override
+    {
+      if (!htif->is_address_preloaded(taddr, len))
+        memif_t::clear(taddr, len);
+    }
+
+    void load_file(addr_t taddr, size_t len, int fd, off_t offset, const void* src) override
+    {
+      if (!htif->is_address_preloaded(taddr, len))
+        memif_t::load_file(taddr, len, fd, offset, src);
+    }
+
    private:
     htif_t* htif;
   } preload_aware_memif(this);
@@ -283,6 +295,9 @@ void htif_t::parse_arguments(int argc, char ** argv)
       case HTIF_LONG_OPTIONS_OPTIND + 5:
         line_size = atoi(optarg);
 
+        break;
+      case HTIF_LONG_OPTIONS_OPTIND + 6:
+        syscall_proxy.enable_stats();
         break;
       case '?':
         if (!opterr)
@@ -322,6 +337,10 @@ void htif_t::parse_arguments(int argc, char ** argv)
             c = HTIF_LONG_OPTIONS_OPTIND + 5;
             optarg = optarg + 23;
         }
+        else if (arg == "+syscall-stats") {
+          c = HTIF_LONG_OPTIONS_OPTIND + 6;
+          optarg = nullptr;
+        }
         else if (arg.find("+permissive-off") == 0) {
           if (opterr)
             throw std::invalid_argument("Found +permissive-off when not parsing permissively");
@@ -70,6 +70,8 @@ class htif_t : public chunked_memif_t
   const std::vector<std::string>& host_args() { return hargs; }
 
   reg_t get_entry_point() { return entry; }
+  addr_t get_tohost_addr() { return tohost_addr; }
+  addr_t get_fromhost_addr() { return fromhost_addr; }
 
   // indicates that the initial program load can skip writing this address
   // range to memory, because it has already been loaded through a sideband
@@ -133,6 +135,8 @@ class htif_t : public chunked_memif_t
        +chroot=PATH\n\
       --payload=PATH       Load PATH memory as an additional ELF payload\n\
        +payload=PATH\n\
+      --syscall-stats      Print per-syscall host time and bytes moved on exit\n\
+       +syscall-stats\n\
 \n\
 HOST OPTIONS (currently unsupported)\n\
       --disk=DISK          Add DISK device. Use a ramdisk since this isn't\n\
@@ -151,6 +155,7 @@ TARGET (RISC-V BINARY) OPTIONS\n\
 {"chroot",    required_argument, 0, HTIF_LONG_OPTIONS_OPTIND + 3 },     \
 {"payload",   required_argument, 0, HTIF_LONG_OPTIONS_OPTIND + 4 },     \
 {"signature-granularity",    optional_argument, 0, HTIF_LONG_OPTIONS_OPTIND + 5 },     \
+{"syscall-stats", no_argument,   0, HTIF_LONG_OPTIONS_OPTIND + 6 },     \
 {0, 0, 0, 0}
 
 #endif // __HTIF_H
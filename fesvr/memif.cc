@@ -83,6 +83,40 @@ void memif_t::write(addr_t addr, size_t len, const void* bytes)
   }
 }
 
+void memif_t::clear(addr_t addr, size_t len)
+{
+  size_t align = cmemif->chunk_align();
+  uint8_t zeros[align];
+  memset(zeros, 0, align);
+
+  if (len && (addr & (align-1)))
+  {
+    size_t this_len = std::min(len, align - size_t(addr & (align-1)));
+    this->write(addr, this_len, zeros);
+
+    addr += this_len;
+    len -= this_len;
+  }
+
+  if (len & (align-1))
+  {
+    size_t this_len = len & (align-1);
+    this->write(addr + len - this_len, this_len, zeros);
+
+    len -= this_len;
+  }
+
+  // now we're aligned
+  if (len)
+    cmemif->clear_chunk(addr, len);
+}
+
+void memif_t::load_file(addr_t addr, size_t len, int fd, off_t offset, const void* bytes)
+{
+  if (!cmemif->load_file(addr, len, fd, offset))
+    this->write(addr, len, bytes);
+}
+
 #define MEMIF_READ_FUNC \
   if(addr & (sizeof(val)-1)) \
     throw std::runtime_error("misaligned address"); \
@@ -5,6 +5,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <sys/types.h>
 #include "byteorder.h"
 
 typedef uint64_t reg_t;
@@ -24,6 +25,14 @@ public:
   virtual void write_chunk(addr_t taddr, size_t len, const void* src) = 0;
   virtual void clear_chunk(addr_t taddr, size_t len) = 0;
 
+  // read len bytes of the file fd at offset directly into target memory;
+  // return false to fall back to writes
+  virtual bool load_file(addr_t taddr, size_t len, int fd, off_t offset) { return false; }
+
+  // return a host pointer to taddr and shrink len to the number of bytes
+  // reachable through it, or NULL if taddr must go through the chunk calls
+  virtual void* host_addr(addr_t taddr, size_t& len) { return NULL; }
+
   virtual size_t chunk_align() = 0;
   virtual size_t chunk_max_size() = 0;
 
@@ -43,6 +52,18 @@ public:
   virtual void read(addr_t addr, size_t len, void* bytes);
   virtual void write(addr_t addr, size_t len, const void* bytes);
 
+  // zero a byte array
+  virtual void clear(addr_t addr, size_t len);
+
+  // copy a byte array from the file fd at offset, reading it straight into
+  // target memory if possible
+  virtual void load_file(addr_t addr, size_t len, int fd, off_t offset, const void* bytes);
+
+  // direct host access to target memory, if the chunked memif allows it
+  virtual void* host_addr(addr_t addr, size_t& len) {
+    return cmemif->host_addr(addr, len);
+  }
+
   // read and write 8-bit words
   virtual target_endian<uint8_t> read_uint8(addr_t addr);
   virtual target_endian<int8_t> read_int8(addr_t addr);
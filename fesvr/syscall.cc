@@ -13,10 +13,15 @@
 #include <termios.h>
 #include <sstream>
 #include <iostream>
+#include <chrono>
 using namespace std::placeholders;
 
 #define RISCV_AT_FDCWD -100
 
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
 struct riscv_stat
 {
   target_endian<uint64_t> dev;
@@ -138,7 +143,8 @@ struct riscv_statx
 #endif
 
 syscall_t::syscall_t(htif_t* htif)
-  : htif(htif), memif(&htif->memif()), table(2048)
+  : htif(htif), memif(&htif->memif()), table(2048), stats_enabled(false),
+    io_bytes(0)
 {
   table[17] = &syscall_t::sys_getcwd;
   table[25] = &syscall_t::sys_fcntl;
@@ -174,6 +180,22 @@ syscall_t::syscall_t(htif_t* htif)
   fds.alloc(stdout_fd1); // stderr -> stdout
 }
 
+syscall_t::~syscall_t()
+{
+  if (!stats_enabled)
+    return;
+
+  fprintf(stderr, "%8s %10s %14s %10s %14s %10s\n",
+          "syscall", "calls", "host usecs", "usecs/call", "bytes", "MB/s");
+  for (auto& s : stats) {
+    double usecs = s.second.nsecs / 1e3;
+    fprintf(stderr, "%8lu %10lu %14.1f %10.2f %14lu %10.1f\n",
+            (unsigned long)s.first, (unsigned long)s.second.calls, usecs,
+            usecs / s.second.calls, (unsigned long)s.second.bytes,
+            usecs ? s.second.bytes / usecs : 0.0);
+  }
+}
+
 std::string syscall_t::do_chroot(const char* fn)
 {
   if (!chroot.empty() && *fn == '/')
@@ -217,11 +239,42 @@ static reg_t sysret_errno(sreg_t ret)
   return ret == -1 ? -errno : ret;
 }
 
+bool syscall_t::target_iovecs(addr_t addr, size_t len)
+{
+  iov.clear();
+  while (len > 0) {
+    size_t n = len;
+    char* p = (char*)memif->host_addr(addr, n);
+    if (!p)
+      return false;
+    if (!iov.empty() && (char*)iov.back().iov_base + iov.back().iov_len == p) {
+      iov.back().iov_len += n;
+    } else {
+      if (iov.size() == IOV_MAX)
+        return false;
+      iov.push_back({p, n});
+    }
+    addr += n;
+    len -= n;
+  }
+  return true;
+}
+
+reg_t syscall_t::io_result(ssize_t ret)
+{
+  if (ret > 0)
+    io_bytes += ret;
+  return sysret_errno(ret);
+}
+
 reg_t syscall_t::sys_read(reg_t fd, reg_t pbuf, reg_t len, reg_t a3, reg_t a4, reg_t a5, reg_t a6)
 {
+  if (target_iovecs(pbuf, len))
+    return io_result(readv(fds.lookup(fd), iov.data(), iov.size()));
+
   std::vector<char> buf(len);
   ssize_t ret = read(fds.lookup(fd), buf.data(), len);
-  reg_t ret_errno = sysret_errno(ret);
+  reg_t ret_errno = io_result(ret);
   if (ret > 0)
     memif->write(pbuf, ret, buf.data());
   return ret_errno;
@@ -229,9 +282,12 @@ reg_t syscall_t::sys_read(reg_t fd, reg_t pbuf, reg_t len, reg_t a3, reg_t a4, r
 
 reg_t syscall_t::sys_pread(reg_t fd, reg_t pbuf, reg_t len, reg_t off, reg_t a4, reg_t a5, reg_t a6)
 {
+  if (target_iovecs(pbuf, len))
+    return io_result(preadv(fds.lookup(fd), iov.data(), iov.size(), off));
+
   std::vector<char> buf(len);
   ssize_t ret = pread(fds.lookup(fd), buf.data(), len, off);
-  reg_t ret_errno = sysret_errno(ret);
+  reg_t ret_errno = io_result(ret);
   if (ret > 0)
     memif->write(pbuf, ret, buf.data());
   return ret_errno;
@@ -239,17 +295,23 @@ reg_t syscall_t::sys_pread(reg_t fd, reg_t pbuf, reg_t len, reg_t off, reg_t a4,
 
 reg_t syscall_t::sys_write(reg_t fd, reg_t pbuf, reg_t len, reg_t a3, reg_t a4, reg_t a5, reg_t a6)
 {
+  if (target_iovecs(pbuf, len))
+    return io_result(writev(fds.lookup(fd), iov.data(), iov.size()));
+
   std::vector<char> buf(len);
   memif->read(pbuf, len, buf.data());
-  reg_t ret = sysret_errno(write(fds.lookup(fd), buf.data(), len));
+  reg_t ret = io_result(write(fds.lookup(fd), buf.data(), len));
   return ret;
 }
 
 reg_t syscall_t::sys_pwrite(reg_t fd, reg_t pbuf, reg_t len, reg_t off, reg_t a4, reg_t a5, reg_t a6)
 {
+  if (target_iovecs(pbuf, len))
+    return io_result(pwritev(fds.lookup(fd), iov.data(), iov.size(), off));
+
   std::vector<char> buf(len);
   memif->read(pbuf, len, buf.data());
-  reg_t ret = sysret_errno(pwrite(fds.lookup(fd), buf.data(), len, off));
+  reg_t ret = io_result(pwrite(fds.lookup(fd), buf.data(), len, off));
   return ret;
 }
 
@@ -454,8 +516,19 @@ void syscall_t::dispatch(reg_t mm)
   if (n >= table.size() || !table[n])
     throw std::runtime_error("bad syscall #" + std::to_string(n));
 
+  auto start = std::chrono::steady_clock::now();
+  io_bytes = 0;
+
   magicmem[0] = htif->to_target((this->*table[n])(htif->from_target(magicmem[1]), htif->from_target(magicmem[2]), htif->from_target(magicmem[3]), htif->from_target(magicmem[4]), htif->from_target(magicmem[5]), htif->from_target(magicmem[6]), htif->from_target(magicmem[7])));
 
+  if (stats_enabled) {
+    auto& s = stats[n];
+    s.calls++;
+    s.nsecs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count();
+    s.bytes += io_bytes;
+  }
+
   memif->write(mm, sizeof(magicmem), magicmem);
 }
 
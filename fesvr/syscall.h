@@ -7,6 +7,8 @@
 #include "memif.h"
 #include <vector>
 #include <string>
+#include <map>
+#include <sys/uio.h>
 
 class syscall_t;
 typedef reg_t (syscall_t::*syscall_func_t)(reg_t, reg_t, reg_t, reg_t, reg_t, reg_t, reg_t);
@@ -28,9 +30,11 @@ class syscall_t : public device_t
 {
  public:
   syscall_t(htif_t*);
+  ~syscall_t();
 
   void set_chroot(const char* where);
-  
+  void enable_stats() { stats_enabled = true; }
+
  private:
   const char* identity() { return "syscall_proxy"; }
 
@@ -46,6 +50,20 @@ class syscall_t : public device_t
   std::string do_chroot(const char* fn);
   std::string undo_chroot(const char* fn);
 
+  // read/write-style calls do their I/O directly on the target buffer
+  // whenever the memif can map it to host memory
+  std::vector<struct iovec> iov;
+  bool target_iovecs(addr_t addr, size_t len);
+  reg_t io_result(ssize_t ret);
+
+  // per-syscall host time and bytes moved, printed on exit
+  struct syscall_stats_t {
+    uint64_t calls, nsecs, bytes;
+  };
+  bool stats_enabled;
+  std::map<reg_t, syscall_stats_t> stats;
+  uint64_t io_bytes;
+
   reg_t sys_exit(reg_t, reg_t, reg_t, reg_t, reg_t, reg_t, reg_t);
   reg_t sys_openat(reg_t, reg_t, reg_t, reg_t, reg_t, reg_t, reg_t);
   reg_t sys_read(reg_t, reg_t, reg_t, reg_t, reg_t, reg_t, reg_t);
@@ -2,6 +2,7 @@
 #include "mmu.h"
 #include "trap.h"
 #include <stdexcept>
+#include <array>
 #include <iostream>
 #include <assert.h>
 #include <math.h>
@@ -54,11 +55,13 @@ void gemmini_t::reset() {
   gemmini_state.reset();
 }
 
+// DRAM is moved a row at a time with mmu_t::load_bytes/store_bytes; these
+// pack and unpack one little-endian element of such a row buffer
 template <class T>
-T gemmini_t::read_from_dram(reg_t addr) {
+T gemmini_t::read_from_dram(const uint8_t *bytes) {
   T value = 0;
   for (size_t byte_idx = 0; byte_idx < sizeof(T); ++byte_idx) {
-    value |= p->get_mmu()->load_uint8(addr + byte_idx) << (byte_idx*8);
+    value |= bytes[byte_idx] << (byte_idx*8);
   }
   return value;
 }
@@ -89,16 +92,21 @@ gemmini_t::read_matrix_from_dram(reg_t addr, reg_t rows, reg_t cols,
     exit(1);
   }
 
-  // Load from memory
+  if (cols == 0)
+    return result;
+
+  // Load from memory; only the leading elem_t of each T-sized slot is used
+  std::vector<uint8_t> row_bytes((cols - 1)*sizeof(T) + sizeof(elem_t));
   for (size_t i = 0; i < rows; i++) {
     auto ii = repeating_bias ? 0 : i;
     auto const dram_row_addr = addr + ii*sizeof(T)*cols;
+    p->get_mmu()->load_bytes(dram_row_addr, row_bytes.size(), row_bytes.data());
     for (size_t j = 0; j < cols; j++) {
-      auto const dram_byte_addr = dram_row_addr + j*sizeof(T);
+      auto const dram_bytes = row_bytes.data() + j*sizeof(T);
 #ifdef ELEM_T_IS_FLOAT
-      result->at(i).at(j) = elem_t_bits_to_elem_t(gemmini_t::read_from_dram<elem_t_bits>(dram_byte_addr));
+      result->at(i).at(j) = elem_t_bits_to_elem_t(gemmini_t::read_from_dram<elem_t_bits>(dram_bytes));
 #else
-      result->at(i).at(j) = gemmini_t::read_from_dram<elem_t>(dram_byte_addr);
+      result->at(i).at(j) = gemmini_t::read_from_dram<elem_t>(dram_bytes);
 #endif
     }
   }
@@ -106,9 +114,9 @@ gemmini_t::read_matrix_from_dram(reg_t addr, reg_t rows, reg_t cols,
 }
 
 template <class T>
-void gemmini_t::write_to_dram(reg_t addr, T data) {
+void gemmini_t::write_to_dram(uint8_t *bytes, T data) {
   for (size_t byte_idx = 0; byte_idx < sizeof(T); ++byte_idx) {
-    p->get_mmu()->store_uint8(addr + byte_idx, (data >> (byte_idx*8)) & 0xFF);
+    bytes[byte_idx] = (data >> (byte_idx*8)) & 0xFF;
   }
 }
 
@@ -133,9 +141,15 @@ void gemmini_t::mvin(reg_t dram_addr, reg_t sp_addr, int state_id) {
 
   dprintf("GEMMINI: mvin - 0x%02lx cols and 0x%02lx rows from 0x%08lx to addr 0x%08lx\n", cols, rows, dram_addr, sp_addr & 0xFFFFFFFF);
 
+  auto const sizeof_input = accumulator && !load_shrunk ? sizeof(acc_t) : sizeof(elem_t);
+  std::vector<uint8_t> row_bytes(cols*sizeof_input);
+
   for (size_t row = 0; row < rows; ++row) {
     auto const dram_row_addr = dram_addr + row*load_stride;
 
+    if (!is_zeros && pixels_per_row > 0)
+      p->get_mmu()->load_bytes(dram_row_addr, row_bytes.size(), row_bytes.data());
+
     for (size_t col = 0; col < cols; ++col) {
       const size_t block = col / DIM;
       const size_t spad_col = col % DIM;
@@ -144,17 +158,16 @@ void gemmini_t::mvin(reg_t dram_addr, reg_t sp_addr, int state_id) {
       for (size_t pixel = 0; pixel < pixels_per_row && pixel <= spad_row; pixel++) {
 
         if (accumulator) {
-            auto const dram_byte_addr = dram_row_addr + col *
-              (load_shrunk ? sizeof(elem_t) : sizeof(acc_t));
+            auto const dram_bytes = row_bytes.data() + col*sizeof_input;
 
             acc_t value;
             if (is_zeros) {
               value = 0;
             } else if (!load_shrunk) {
 #ifdef ELEM_T_IS_FLOAT
-              value = acc_t_bits_to_acc_t(read_from_dram<acc_t_bits>(dram_byte_addr));
+              value = acc_t_bits_to_acc_t(read_from_dram<acc_t_bits>(dram_bytes));
 #else
-              value = read_from_dram<acc_t>(dram_byte_addr);
+              value = read_from_dram<acc_t>(dram_bytes);
 #endif
 
 #ifdef HAS_MVIN_ACC_SCALE
@@ -162,9 +175,9 @@ void gemmini_t::mvin(reg_t dram_addr, reg_t sp_addr, int state_id) {
 #endif
             } else {
 #ifdef ELEM_T_IS_FLOAT
-              value = elem_t_bits_to_elem_t(read_from_dram<elem_t_bits>(dram_byte_addr));
+              value = elem_t_bits_to_elem_t(read_from_dram<elem_t_bits>(dram_bytes));
 #else
-              value = read_from_dram<elem_t>(dram_byte_addr);
+              value = read_from_dram<elem_t>(dram_bytes);
 #endif
 
 #ifdef HAS_MVIN_SCALE
@@ -184,16 +197,16 @@ void gemmini_t::mvin(reg_t dram_addr, reg_t sp_addr, int state_id) {
             dprintf("%d ", gemmini_state.accumulator.at(spad_row).at(spad_col));
 #endif
         } else {
-            auto const dram_byte_addr = dram_row_addr + col*sizeof(elem_t);
+            auto const dram_bytes = row_bytes.data() + col*sizeof_input;
 
             elem_t value;
             if (is_zeros) {
               value = 0;
             } else {
 #ifdef ELEM_T_IS_FLOAT
-              value = elem_t_bits_to_elem_t(read_from_dram<elem_t_bits>(dram_byte_addr));
+              value = elem_t_bits_to_elem_t(read_from_dram<elem_t_bits>(dram_bytes));
 #else
-              value = read_from_dram<elem_t>(dram_byte_addr);
+              value = read_from_dram<elem_t>(dram_bytes);
 #endif
 
 #ifdef HAS_MVIN_SCALE
@@ -228,6 +241,9 @@ void gemmini_t::mvout(reg_t dram_addr, reg_t sp_addr) {
   dprintf("GEMMINI: mvout - 0x%02lx cols and 0x%02lx rows from 0x%08lx to addr 0x%08lx\n", cols, rows, sp_addr, dram_addr);
 
   if (gemmini_state.pool_stride == 0) {
+    auto const sizeof_output = accumulator && full ? sizeof(acc_t) : sizeof(elem_t);
+    std::vector<uint8_t> row_bytes(cols*sizeof_output);
+
     for (size_t i = 0; i < rows; ++i) {
       auto const dram_row_addr = dram_addr + i*gemmini_state.store_stride;
 
@@ -260,40 +276,39 @@ void gemmini_t::mvout(reg_t dram_addr, reg_t sp_addr) {
           auto shifted = acc_scale(acc_value, gemmini_state.acc_shift);
           elem_t activated = apply_activation_acc(shifted); // Activation is always applied in either WS/OS mode
 
-          auto const sizeof_output = full ? sizeof(acc_t) : sizeof(elem_t);
-
-          auto const dram_byte_addr = dram_row_addr + j*sizeof_output;
+          auto const dram_bytes = row_bytes.data() + j*sizeof_output;
 #ifdef ELEM_T_IS_FLOAT
           if (full) {
-            write_to_dram<acc_t_bits>(dram_byte_addr, acc_t_to_acc_t_bits(acc_value));
+            write_to_dram<acc_t_bits>(dram_bytes, acc_t_to_acc_t_bits(acc_value));
             dprintf("%f ", acc_value);
           } else {
-            write_to_dram<elem_t_bits>(dram_byte_addr, elem_t_to_elem_t_bits(activated));
+            write_to_dram<elem_t_bits>(dram_bytes, elem_t_to_elem_t_bits(activated));
             dprintf("%f ", activated);
           }
 #else
           if (full) {
-            write_to_dram<acc_t>(dram_byte_addr, acc_value);
+            write_to_dram<acc_t>(dram_bytes, acc_value);
             dprintf("%d ", acc_value);
           } else {
-            write_to_dram<elem_t>(dram_byte_addr, activated);
+            write_to_dram<elem_t>(dram_bytes, activated);
             dprintf("%d ", activated);
           }
 #endif
 
         } else { // Scratchpad, write to DRAM directly
-          auto const dram_byte_addr = dram_row_addr + j*sizeof(elem_t);
+          auto const dram_bytes = row_bytes.data() + j*sizeof_output;
           elem_t value = gemmini_state.spad.at(spad_row).at(spad_col);
 
 #ifdef ELEM_T_IS_FLOAT
-          write_to_dram<elem_t_bits>(dram_byte_addr, elem_t_to_elem_t_bits(value));
+          write_to_dram<elem_t_bits>(dram_bytes, elem_t_to_elem_t_bits(value));
           dprintf("%f ", value);
 #else
-          write_to_dram<elem_t>(dram_byte_addr, value);
+          write_to_dram<elem_t>(dram_bytes, value);
           dprintf("%d ", value);
 #endif
         }
       }
+      p->get_mmu()->store_bytes(dram_row_addr, row_bytes.size(), row_bytes.data());
       dprintf("\n");
     }
 
@@ -310,6 +325,7 @@ void gemmini_t::mvout(reg_t dram_addr, reg_t sp_addr) {
     auto const plpad = gemmini_state.pool_lpad;
     auto const pupad = gemmini_state.pool_upad;
     auto const channels = cols;
+    std::vector<uint8_t> pixel_bytes(channels*sizeof(elem_t));
 
     for (int porow = 0; porow < porows; porow++) {
       for (int pocol = 0; pocol < pocols; pocol++) {
@@ -342,14 +358,17 @@ void gemmini_t::mvout(reg_t dram_addr, reg_t sp_addr) {
             }
           }
 
-          auto const dram_byte_addr = dram_addr + (porow * pool_out_dim + pocol) * gemmini_state.store_stride + poch * sizeof(elem_t);
+          auto const dram_bytes = pixel_bytes.data() + poch * sizeof(elem_t);
 
 #ifdef ELEM_T_IS_FLOAT
-          write_to_dram<elem_t_bits>(dram_byte_addr, elem_t_to_elem_t_bits(value));
+          write_to_dram<elem_t_bits>(dram_bytes, elem_t_to_elem_t_bits(value));
 #else
-          write_to_dram<elem_t>(dram_byte_addr, value);
+          write_to_dram<elem_t>(dram_bytes, value);
 #endif
         }
+
+        auto const dram_pixel_addr = dram_addr + (porow * pool_out_dim + pocol) * gemmini_state.store_stride;
+        p->get_mmu()->store_bytes(dram_pixel_addr, pixel_bytes.size(), pixel_bytes.data());
       }
     }
   }
@@ -531,16 +550,17 @@ void gemmini_t::compute(reg_t a_addr, reg_t bd_addr, bool preload) {
 
   // Preload
   if (preload) {
+    // TODO: Handle preloads from accumulator, values are shifted and activated before preload
+    if (~gemmini_state.preload_sp_addr != 0) {
+      assert(((gemmini_state.preload_sp_addr >> 30) & 0b11) == 0); // Preloads from accumulator not supported
+    }
+
+    bool preload_tranpose = (gemmini_state.mode == gemmini_state_t::WS) &&
+      gemmini_state.b_transpose;
+
     dprintf("GEMMINI: compute - PEs after preloading:\n");
     for (size_t i = 0; i < DIM; i++) {
       for (size_t j = 0; j < DIM; j++) {
-        // TODO: Handle preloads from accumulator, values are shifted and activated before preload
-        if (~gemmini_state.preload_sp_addr != 0) {
-          assert(((gemmini_state.preload_sp_addr >> 30) & 0b11) == 0); // Preloads from accumulator not supported
-        }
-
-        bool preload_tranpose = (gemmini_state.mode == gemmini_state_t::WS) &&
-          gemmini_state.b_transpose;
         size_t r = preload_tranpose ? j : i;
         size_t c = preload_tranpose ? i : j;
 
@@ -564,46 +584,66 @@ void gemmini_t::compute(reg_t a_addr, reg_t bd_addr, bool preload) {
     }
   }
 
+  // Gather the (possibly transposed, zero-padded) operands into dense
+  // row-major tiles once, so the multiply below runs on contiguous rows
+  // without per-element bounds checks and can be vectorized by the compiler
+  elem_t a_tile[DIM][DIM];
+  for (size_t i = 0; i < DIM; ++i) {
+    for (size_t k = 0; k < DIM; ++k) {
+      elem_t a = 0;
+      if (~a_addr_real != 0 && i < a_rows && k < a_cols) {
+        const size_t r = gemmini_state.a_stride * (gemmini_state.a_transpose ? k : i);
+        const size_t c = gemmini_state.a_transpose ? i : k;
+        a = gemmini_state.spad.at(a_addr_real + r).at(c);
+      }
+      a_tile[i][k] = a;
+    }
+  }
+
   // Compute
   // For OS, accumulate the PE results internally in pe_state
   // For WS, allocate a new results array which won't affect pe_state, seed the results array with the bias (D) matrix
-  auto results = std::vector<std::vector<acc_t>>(DIM, std::vector<acc_t>(DIM));
-  for (size_t i = 0; i < DIM; ++i) {
-    for (size_t j = 0; j < DIM; ++j) {
-      if (i < bd_rows && j < bd_cols) {
-        results.at(i).at(j) = (~bd_addr_real == 0) ? 0 : gemmini_state.spad.at(bd_addr_real + i).at(j);
-      } else {
-        results.at(i).at(j) = 0;
+  std::array<std::array<acc_t, DIM>, DIM> results;
+  if (gemmini_state.mode == gemmini_state_t::WS) {
+    for (size_t i = 0; i < DIM; ++i) {
+      for (size_t j = 0; j < DIM; ++j) {
+        if (i < bd_rows && j < bd_cols) {
+          results[i][j] = (~bd_addr_real == 0) ? 0 : gemmini_state.spad.at(bd_addr_real + i).at(j);
+        } else {
+          results[i][j] = 0;
+        }
       }
     }
-  }
 
-  for (size_t i = 0; i < DIM; ++i) {
-    for (size_t j = 0; j < DIM; ++j) {
+    for (size_t i = 0; i < DIM; ++i) {
       for (size_t k = 0; k < DIM; ++k) {
-        elem_t a;
-        if (~a_addr_real != 0) {
-            const size_t r = gemmini_state.a_stride * (gemmini_state.a_transpose ? k : i);
-            const size_t c = gemmini_state.a_transpose ? i : k;
-
-            a = i < a_rows && k < a_cols ? gemmini_state.spad.at(a_addr_real + r).at(c) : 0;
+        const elem_t a = a_tile[i][k];
+        const acc_t * const weights = gemmini_state.pe_state[k].data();
+        for (size_t j = 0; j < DIM; ++j) {
+          results[i][j] += a * weights[j];
         }
+      }
+    }
+  } else {
+    elem_t b_tile[DIM][DIM];
+    for (size_t k = 0; k < DIM; ++k) {
+      for (size_t j = 0; j < DIM; ++j) {
+        elem_t b = 0;
+        if (~bd_addr_real != 0 && k < bd_rows && j < bd_cols) {
+          const size_t r = gemmini_state.b_transpose ? j : k;
+          const size_t c = gemmini_state.b_transpose ? k : j;
+          b = gemmini_state.spad.at(bd_addr_real + r).at(c);
+        }
+        b_tile[k][j] = b;
+      }
+    }
 
-        if (gemmini_state.mode == gemmini_state_t::WS) {
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
-          results.at(i).at(j) += a * gemmini_state.pe_state.at(k).at(j);
-#pragma GCC diagnostic pop
-        } else {
-          elem_t b = 0;
-          if (~bd_addr_real != 0) {
-            const size_t r = gemmini_state.b_transpose ? j : k;
-            const size_t c = gemmini_state.b_transpose ? k : j;
-
-            b = k < bd_rows && j < bd_cols ? gemmini_state.spad.at(bd_addr_real + r).at(c) : 0;
-          }
-
-          gemmini_state.pe_state.at(i).at(j) += a * b;
+    for (size_t i = 0; i < DIM; ++i) {
+      acc_t * const pe_row = gemmini_state.pe_state[i].data();
+      for (size_t k = 0; k < DIM; ++k) {
+        const elem_t a = a_tile[i][k];
+        for (size_t j = 0; j < DIM; ++j) {
+          pe_row[j] += a * b_tile[k][j];
         }
       }
     }
@@ -879,14 +919,20 @@ void gemmini_t::compute_cisc() {
   // Initialize an accumulator/ result
   auto C = matrix_zeroes<elem_t>(gemmini_state.m, gemmini_state.n);
 
-  // Multiply & apply activation
+  // Multiply & apply activation, accumulating a whole row of C at a time
+  // so the inner loop walks contiguous rows of B
+  std::vector<acc_t> row(gemmini_state.n);
   for (size_t i=0; i<gemmini_state.m; i++) {
-    for (size_t j=0; j<gemmini_state.n; j++) {
-      acc_t value = D->at(i).at(j);
-      for (size_t k=0; k<gemmini_state.k; k++) {
-        value += ((acc_t)A->at(i).at(k)) * ((acc_t)B->at(k).at(j));
+    row = D->at(i);
+    for (size_t k=0; k<gemmini_state.k; k++) {
+      const acc_t a = A->at(i).at(k);
+      const elem_t * const b_row = B->at(k).data();
+      for (size_t j=0; j<gemmini_state.n; j++) {
+        row[j] += a * ((acc_t)b_row[j]);
       }
-      elem_t shifted = acc_scale(value,
+    }
+    for (size_t j=0; j<gemmini_state.n; j++) {
+      elem_t shifted = acc_scale(row[j],
                           gemmini_state.acc_shift);
       elem_t activated = apply_activation_acc(shifted);
       C->at(i).at(j) = activated;
@@ -894,18 +940,25 @@ void gemmini_t::compute_cisc() {
   }
 
   // Write back to memory
+  std::vector<uint8_t> row_bytes(gemmini_state.n*sizeof(elem_t));
   for (size_t i = 0; i < gemmini_state.m; i++) {
     auto const dram_row_addr = gemmini_state.c_addr +
                                i*sizeof(elem_t)*gemmini_state.n;
     for (size_t j = 0; j < gemmini_state.n; j++) {
-      auto const dram_byte_addr = dram_row_addr + j*sizeof(elem_t);
+      auto const dram_bytes = row_bytes.data() + j*sizeof(elem_t);
 #ifdef ELEM_T_IS_FLOAT
-      write_to_dram<elem_t_bits>(dram_byte_addr, C->at(i).at(j));
+      write_to_dram<elem_t_bits>(dram_bytes, C->at(i).at(j));
 #else
-      write_to_dram<elem_t>(dram_byte_addr, C->at(i).at(j));
+      write_to_dram<elem_t>(dram_bytes, C->at(i).at(j));
 #endif
     }
+    p->get_mmu()->store_bytes(dram_row_addr, row_bytes.size(), row_bytes.data());
   }
+
+  delete A;
+  delete B;
+  delete C;
+  delete D;
 }
 
 // Union for counter operation argument extraction
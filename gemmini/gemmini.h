@@ -222,7 +222,7 @@ private:
   elem_t sys_shift(output_t value, unsigned int shift);
 
   template <class T>
-  T read_from_dram(reg_t addr);
+  T read_from_dram(const uint8_t *bytes);
 
   template <class T>
   std::vector<std::vector<T>> *
@@ -230,7 +230,7 @@ private:
                         bool zeroable, bool repeating_bias);
 
   template <class T>
-  void write_to_dram(reg_t addr, T data);
+  void write_to_dram(uint8_t *bytes, T data);
 
 #ifdef ELEM_T_IS_FLOAT
   elem_t elem_t_bits_to_elem_t(elem_t_bits x);
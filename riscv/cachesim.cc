@@ -6,8 +6,9 @@
 #include <iostream>
 #include <iomanip>
 
-cache_sim_t::cache_sim_t(size_t _sets, size_t _ways, size_t _linesz, const char* _name)
-: sets(_sets), ways(_ways), linesz(_linesz), name(_name), log(false)
+cache_sim_t::cache_sim_t(size_t _sets, size_t _ways, size_t _linesz, const char* _name,
+                         replacement_policy_t _policy)
+: sets(_sets), ways(_ways), linesz(_linesz), policy(_policy), name(_name), log(false)
 {
   init();
 }
@@ -15,9 +16,11 @@ cache_sim_t::cache_sim_t(size_t _sets, size_t _ways, size_t _linesz, const char*
 static void help()
 {
   std::cerr << "Cache configurations must be of the form" << std::endl;
-  std::cerr << "  sets:ways:blocksize" << std::endl;
+  std::cerr << "  sets:ways:blocksize[:policy]" << std::endl;
   std::cerr << "where sets, ways, and blocksize are positive integers, with" << std::endl;
-  std::cerr << "sets and blocksize both powers of two and blocksize at least 8." << std::endl;
+  std::cerr << "sets and blocksize both powers of two and blocksize at least 8," << std::endl;
+  std::cerr << "and policy is random (the default), lru, or plru.  plru also" << std::endl;
+  std::cerr << "requires ways to be a power of two." << std::endl;
   exit(1);
 }
 
@@ -27,14 +30,25 @@ cache_sim_t* cache_sim_t::construct(const char* config, const char* name)
   if (!wp++) help();
   const char* bp = strchr(wp, ':');
   if (!bp++) help();
+  const char* pp = strchr(bp, ':');
 
   size_t sets = atoi(std::string(config, wp).c_str());
   size_t ways = atoi(std::string(wp, bp).c_str());
-  size_t linesz = atoi(bp);
+  size_t linesz = atoi(pp ? std::string(bp, pp).c_str() : bp);
+
+  replacement_policy_t policy = REPLACE_RANDOM;
+  if (pp++) {
+    if (strcmp(pp, "lru") == 0)
+      policy = REPLACE_LRU;
+    else if (strcmp(pp, "plru") == 0)
+      policy = REPLACE_PLRU;
+    else if (strcmp(pp, "random") != 0)
+      help();
+  }
 
   if (ways > 4 /* empirical */ && sets == 1)
-    return new fa_cache_sim_t(ways, linesz, name);
-  return new cache_sim_t(sets, ways, linesz, name);
+    return new fa_cache_sim_t(ways, linesz, name, policy);
+  return new cache_sim_t(sets, ways, linesz, name, policy);
 }
 
 void cache_sim_t::init()
@@ -43,12 +57,20 @@ void cache_sim_t::init()
     help();
   if(linesz < 8 || (linesz & (linesz-1)))
     help();
+  if(ways == 0 || (policy == REPLACE_PLRU && (ways & (ways-1))))
+    help();
 
   idx_shift = 0;
   for (size_t x = linesz; x>1; x >>= 1)
     idx_shift++;
 
   tags = new uint64_t[sets*ways]();
+  if (policy == REPLACE_LRU)
+    lru_stamps.resize(sets*ways);
+  if (policy == REPLACE_PLRU)
+    plru_bits.resize(sets*ways);
+  lru_clock = 0;
+
   read_accesses = 0;
   read_misses = 0;
   bytes_read = 0;
@@ -56,13 +78,15 @@ void cache_sim_t::init()
   write_misses = 0;
   bytes_written = 0;
   writebacks = 0;
+  coherence_misses = 0;
 
   miss_handler = NULL;
 }
 
 cache_sim_t::cache_sim_t(const cache_sim_t& rhs)
  : sets(rhs.sets), ways(rhs.ways), linesz(rhs.linesz),
-   idx_shift(rhs.idx_shift), name(rhs.name), log(false)
+   idx_shift(rhs.idx_shift), policy(rhs.policy), lru_stamps(rhs.lru_stamps),
+   lru_clock(rhs.lru_clock), plru_bits(rhs.plru_bits), name(rhs.name), log(false)
 {
   tags = new uint64_t[sets*ways];
   memcpy(tags, rhs.tags, sets*ways*sizeof(uint64_t));
@@ -94,33 +118,137 @@ void cache_sim_t::print_stats()
   std::cout << "Read Misses:           " << read_misses << std::endl;
   std::cout << name << " ";
   std::cout << "Write Misses:          " << write_misses << std::endl;
+  if (!peers.empty()) {
+    std::cout << name << " ";
+    std::cout << "Coherence Misses:      " << coherence_misses << std::endl;
+  }
   std::cout << name << " ";
   std::cout << "Writebacks:            " << writebacks << std::endl;
   std::cout << name << " ";
   std::cout << "Miss Rate:             " << mr << '%' << std::endl;
 }
 
-uint64_t* cache_sim_t::check_tag(uint64_t addr)
+uint64_t* cache_sim_t::lookup(uint64_t addr)
 {
   size_t idx = (addr >> idx_shift) & (sets-1);
-  size_t tag = (addr >> idx_shift) | VALID;
+  uint64_t tag = (addr >> idx_shift) | VALID;
+  uint64_t* set = &tags[idx*ways];
 
+  // Compare every way without an early exit, so the loop has no
+  // data-dependent branches and the compiler can vectorize it.
+  size_t hit = ways;
   for (size_t i = 0; i < ways; i++)
-    if (tag == (tags[idx*ways + i] & ~DIRTY))
-      return &tags[idx*ways + i];
+    hit = tag == (set[i] & ~DIRTY) ? i : hit;
+
+  return hit == ways ? NULL : &set[hit];
+}
 
-  return NULL;
+uint64_t* cache_sim_t::check_tag(uint64_t addr)
+{
+  uint64_t* line = lookup(addr);
+  if (line)
+    touch(line - tags);
+  return line;
+}
+
+void cache_sim_t::touch(size_t line)
+{
+  switch (policy) {
+    case REPLACE_RANDOM:
+      break;
+    case REPLACE_LRU:
+      lru_stamps[line] = ++lru_clock;
+      break;
+    case REPLACE_PLRU: {
+      // point each node on the way's path at the other subtree
+      uint8_t* tree = &plru_bits[line / ways * ways];
+      for (size_t node = line % ways + ways; node > 1; node /= 2)
+        tree[node / 2] = !(node & 1);
+      break;
+    }
+  }
+}
+
+size_t cache_sim_t::victim_way(size_t idx)
+{
+  switch (policy) {
+    case REPLACE_LRU: {
+      // invalid lines have a zero stamp, so they go first
+      const uint64_t* stamps = &lru_stamps[idx*ways];
+      size_t way = 0;
+      for (size_t i = 1; i < ways; i++)
+        way = stamps[i] < stamps[way] ? i : way;
+      return way;
+    }
+    case REPLACE_PLRU: {
+      const uint8_t* tree = &plru_bits[idx*ways];
+      size_t node = 1;
+      while (node < ways)
+        node = 2*node + tree[node];
+      return node - ways;
+    }
+    default:
+      return lfsr.next() % ways;
+  }
 }
 
 uint64_t cache_sim_t::victimize(uint64_t addr)
 {
   size_t idx = (addr >> idx_shift) & (sets-1);
-  size_t way = lfsr.next() % ways;
+  size_t way = victim_way(idx);
   uint64_t victim = tags[idx*ways + way];
   tags[idx*ways + way] = (addr >> idx_shift) | VALID;
+  touch(idx*ways + way);
   return victim;
 }
 
+void cache_sim_t::writeback(uint64_t victim)
+{
+  uint64_t dirty_addr = (victim & ~(VALID | DIRTY)) << idx_shift;
+  if (miss_handler)
+    miss_handler->access(dirty_addr, linesz, true);
+  writebacks++;
+}
+
+void cache_sim_t::invalidate(uint64_t addr)
+{
+  uint64_t* line = lookup(addr);
+  if (!line)
+    return;
+
+  if (*line & DIRTY)
+    writeback(*line);
+  // keep the tag, so a miss on it until the way is refilled is a
+  // coherence miss
+  *line = (*line & ~(VALID | DIRTY)) | STOLEN;
+  if (policy == REPLACE_LRU)
+    lru_stamps[line - tags] = 0;
+}
+
+bool cache_sim_t::take_stolen(uint64_t addr)
+{
+  size_t idx = (addr >> idx_shift) & (sets-1);
+  uint64_t tag = (addr >> idx_shift) | STOLEN;
+  uint64_t* set = &tags[idx*ways];
+
+  for (size_t i = 0; i < ways; i++) {
+    if (set[i] == tag) {
+      set[i] = 0;
+      return true;
+    }
+  }
+  return false;
+}
+
+void cache_sim_t::clean(uint64_t addr)
+{
+  uint64_t* line = lookup(addr);
+  if (line && (*line & DIRTY)) {
+    writeback(*line);
+    *line &= ~DIRTY;
+  }
+}
+
 void cache_sim_t::access(uint64_t addr, size_t bytes, bool store)
 {
   store ? write_accesses++ : read_accesses++;
@@ -129,12 +257,17 @@ void cache_sim_t::access(uint64_t addr, size_t bytes, bool store)
   uint64_t* hit_way = check_tag(addr);
   if (likely(hit_way != NULL))
   {
-    if (store)
+    if (store) {
       *hit_way |= DIRTY;
+      for (auto peer : peers)
+        peer->invalidate(addr);
+    }
     return;
   }
 
   store ? write_misses++ : read_misses++;
+  if (!peers.empty() && take_stolen(addr))
+    coherence_misses++;
   if (log)
   {
     std::cerr << name << " "
@@ -142,44 +275,138 @@ void cache_sim_t::access(uint64_t addr, size_t bytes, bool store)
               << std::hex << addr << std::endl;
   }
 
+  // a store takes the line exclusively; a load just needs peers'
+  // dirty copies written back first
+  for (auto peer : peers)
+    store ? peer->invalidate(addr) : peer->clean(addr);
+
   uint64_t victim = victimize(addr);
 
   if ((victim & (VALID | DIRTY)) == (VALID | DIRTY))
-  {
-    uint64_t dirty_addr = (victim & ~(VALID | DIRTY)) << idx_shift;
-    if (miss_handler)
-      miss_handler->access(dirty_addr, linesz, true);
-    writebacks++;
-  }
+    writeback(victim);
 
   if (miss_handler)
     miss_handler->access(addr & ~(linesz-1), linesz, false);
 
   if (store)
-    *check_tag(addr) |= DIRTY;
+    *lookup(addr) |= DIRTY;
 }
 
-fa_cache_sim_t::fa_cache_sim_t(size_t ways, size_t linesz, const char* name)
-  : cache_sim_t(1, ways, linesz, name)
+fa_cache_sim_t::fa_cache_sim_t(size_t ways, size_t linesz, const char* name,
+                               replacement_policy_t policy)
+  : cache_sim_t(1, ways, linesz, name, policy)
 {
+  for (size_t i = ways; i > 0; i--)
+    free_ways.push_back(i - 1);
 }
 
-uint64_t* fa_cache_sim_t::check_tag(uint64_t addr)
+uint64_t* fa_cache_sim_t::lookup(uint64_t addr)
 {
-  auto it = tags.find(addr >> idx_shift);
-  return it == tags.end() ? NULL : &it->second;
+  auto it = way_of.find(addr >> idx_shift);
+  return it == way_of.end() ? NULL : &tags[it->second];
 }
 
 uint64_t fa_cache_sim_t::victimize(uint64_t addr)
 {
-  uint64_t old_tag = 0;
-  if (tags.size() == ways)
+  size_t way;
+  if (!free_ways.empty()) {
+    way = free_ways.back();
+    free_ways.pop_back();
+  } else {
+    way = victim_way(0);
+    way_of.erase(tags[way] & ~(VALID | DIRTY));
+  }
+
+  uint64_t victim = tags[way];
+  tags[way] = (addr >> idx_shift) | VALID;
+  way_of[addr >> idx_shift] = way;
+  touch(way);
+  return victim;
+}
+
+void fa_cache_sim_t::invalidate(uint64_t addr)
+{
+  auto it = way_of.find(addr >> idx_shift);
+  if (it == way_of.end())
+    return;
+
+  size_t way = it->second;
+  cache_sim_t::invalidate(addr);
+  way_of.erase(it);
+  free_ways.push_back(way);
+}
+
+bool fa_cache_sim_t::take_stolen(uint64_t addr)
+{
+  // only free ways can hold a stolen line
+  uint64_t tag = (addr >> idx_shift) | STOLEN;
+  for (size_t way : free_ways) {
+    if (tags[way] == tag) {
+      tags[way] = 0;
+      return true;
+    }
+  }
+  return false;
+}
+
+void cache_memtracer_t::set_thread(cache_sim_thread_t* t)
+{
+  thread = t;
+  thread->add_tracer(this);
+  batch.reserve(BATCH_SIZE);
+}
+
+void cache_memtracer_t::flush()
+{
+  if (batch.empty())
+    return;
+
+  thread->submit(this, std::move(batch));
+  batch.clear();
+  batch.reserve(BATCH_SIZE);
+}
+
+cache_sim_thread_t::cache_sim_thread_t()
+  : exiting(false), thread(&cache_sim_thread_t::main, this)
+{
+}
+
+cache_sim_thread_t::~cache_sim_thread_t()
+{
+  for (auto tracer : tracers)
+    tracer->flush();
+
   {
-    auto it = tags.begin();
-    std::advance(it, lfsr.next() % ways);
-    old_tag = it->second;
-    tags.erase(it);
+    std::lock_guard<std::mutex> guard(lock);
+    exiting = true;
+  }
+  queued.notify_one();
+  thread.join();
+}
+
+void cache_sim_thread_t::submit(cache_memtracer_t* tracer,
+                                std::vector<cache_access_t>&& batch)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  dequeued.wait(guard, [&]{ return queue.size() < MAX_QUEUED; });
+  queue.emplace_back(tracer, std::move(batch));
+  guard.unlock();
+  queued.notify_one();
+}
+
+void cache_sim_thread_t::main()
+{
+  while (true) {
+    std::unique_lock<std::mutex> guard(lock);
+    queued.wait(guard, [&]{ return !queue.empty() || exiting; });
+    if (queue.empty())
+      return;
+
+    auto work = std::move(queue.front());
+    queue.pop_front();
+    guard.unlock();
+    dequeued.notify_all();
+
+    work.first->replay(work.second);
   }
-  tags[addr >> idx_shift] = (addr >> idx_shift) | VALID;
-  return old_tag;
 }
@@ -6,7 +6,12 @@
 #include "memtracer.h"
 #include <cstring>
 #include <string>
-#include <map>
+#include <unordered_map>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 #include <cstdint>
 
 class lfsr_t
@@ -19,10 +24,17 @@ class lfsr_t
   uint32_t reg;
 };
 
+enum replacement_policy_t {
+  REPLACE_RANDOM, // LFSR-chosen way
+  REPLACE_LRU,
+  REPLACE_PLRU,   // tree pseudo-LRU; needs a power-of-2 number of ways
+};
+
 class cache_sim_t
 {
  public:
-  cache_sim_t(size_t sets, size_t ways, size_t linesz, const char* name);
+  cache_sim_t(size_t sets, size_t ways, size_t linesz, const char* name,
+              replacement_policy_t policy = REPLACE_RANDOM);
   cache_sim_t(const cache_sim_t& rhs);
   virtual ~cache_sim_t();
 
@@ -31,25 +43,46 @@ class cache_sim_t
   void set_miss_handler(cache_sim_t* mh) { miss_handler = mh; }
   void set_log(bool _log) { log = _log; }
 
+  // Keep this cache coherent with a peer (e.g. another hart's D$) by
+  // write-invalidate: a store here invalidates the line in the peer.
+  void add_peer(cache_sim_t* peer) { peers.push_back(peer); }
+
+  // config is sets:ways:blocksize[:random|lru|plru]
   static cache_sim_t* construct(const char* config, const char* name);
 
  protected:
   static const uint64_t VALID = 1ULL << 63;
   static const uint64_t DIRTY = 1ULL << 62;
+  static const uint64_t STOLEN = 1ULL << 61; // invalid: a peer took it
 
-  virtual uint64_t* check_tag(uint64_t addr);
+  // find the line holding addr, without updating the replacement state
+  virtual uint64_t* lookup(uint64_t addr);
+  uint64_t* check_tag(uint64_t addr);
   virtual uint64_t victimize(uint64_t addr);
+  virtual void invalidate(uint64_t addr);
+  virtual bool take_stolen(uint64_t addr);
+  void clean(uint64_t addr);
+  void writeback(uint64_t victim);
+
+  // replacement state
+  void touch(size_t line);
+  size_t victim_way(size_t idx);
 
   lfsr_t lfsr;
   cache_sim_t* miss_handler;
+  std::vector<cache_sim_t*> peers;
 
   size_t sets;
   size_t ways;
   size_t linesz;
   size_t idx_shift;
+  replacement_policy_t policy;
 
   uint64_t* tags;
-  
+  std::vector<uint64_t> lru_stamps;
+  uint64_t lru_clock;
+  std::vector<uint8_t> plru_bits; // ways-1 tree nodes per set, from index 1
+
   uint64_t read_accesses;
   uint64_t read_misses;
   uint64_t bytes_read;
@@ -57,6 +90,7 @@ class cache_sim_t
   uint64_t write_misses;
   uint64_t bytes_written;
   uint64_t writebacks;
+  uint64_t coherence_misses;
 
   std::string name;
   bool log;
@@ -67,18 +101,30 @@ class cache_sim_t
 class fa_cache_sim_t : public cache_sim_t
 {
  public:
-  fa_cache_sim_t(size_t ways, size_t linesz, const char* name);
-  uint64_t* check_tag(uint64_t addr);
+  fa_cache_sim_t(size_t ways, size_t linesz, const char* name,
+                 replacement_policy_t policy = REPLACE_RANDOM);
+  uint64_t* lookup(uint64_t addr);
   uint64_t victimize(uint64_t addr);
+  void invalidate(uint64_t addr);
+  bool take_stolen(uint64_t addr);
  private:
-  static bool cmp(uint64_t a, uint64_t b);
-  std::map<uint64_t, uint64_t> tags;
+  std::unordered_map<uint64_t, size_t> way_of; // line -> way
+  std::vector<size_t> free_ways;
 };
 
+struct cache_access_t {
+  uint64_t addr;
+  size_t bytes;
+  access_type type;
+};
+
+class cache_sim_thread_t;
+
 class cache_memtracer_t : public memtracer_t
 {
  public:
   cache_memtracer_t(const char* config, const char* name)
+    : thread(NULL)
   {
     cache = cache_sim_t::construct(config, name);
   }
@@ -94,37 +140,95 @@ class cache_memtracer_t : public memtracer_t
   {
     cache->set_log(log);
   }
+  cache_sim_t* get_cache() { return cache; }
+
+  // Simulate accesses on the given thread, in batches, rather than inline.
+  void set_thread(cache_sim_thread_t* t);
+  void trace(uint64_t addr, size_t bytes, access_type type)
+  {
+    if (!interested_in_range(addr, addr + bytes, type))
+      return;
+    if (!thread) {
+      access(addr, bytes, type);
+      return;
+    }
+    batch.push_back({addr, bytes, type});
+    if (batch.size() == BATCH_SIZE)
+      flush();
+  }
+  // hand any buffered accesses to the thread
+  void flush();
+  void replay(const std::vector<cache_access_t>& accesses)
+  {
+    for (auto& a : accesses)
+      access(a.addr, a.bytes, a.type);
+  }
 
  protected:
+  virtual void access(uint64_t addr, size_t bytes, access_type type) = 0;
+
   cache_sim_t* cache;
+  cache_sim_thread_t* thread;
+  static const size_t BATCH_SIZE = 4096;
+  std::vector<cache_access_t> batch;
 };
 
 class icache_sim_t : public cache_memtracer_t
 {
  public:
-  icache_sim_t(const char* config) : cache_memtracer_t(config, "I$") {}
+  icache_sim_t(const char* config, const char* name = "I$") : cache_memtracer_t(config, name) {}
   bool interested_in_range(uint64_t begin, uint64_t end, access_type type)
   {
     return type == FETCH;
   }
-  void trace(uint64_t addr, size_t bytes, access_type type)
+ protected:
+  void access(uint64_t addr, size_t bytes, access_type type)
   {
-    if (type == FETCH) cache->access(addr, bytes, false);
+    cache->access(addr, bytes, false);
   }
 };
 
 class dcache_sim_t : public cache_memtracer_t
 {
  public:
-  dcache_sim_t(const char* config) : cache_memtracer_t(config, "D$") {}
+  dcache_sim_t(const char* config, const char* name = "D$") : cache_memtracer_t(config, name) {}
   bool interested_in_range(uint64_t begin, uint64_t end, access_type type)
   {
     return type == LOAD || type == STORE;
   }
-  void trace(uint64_t addr, size_t bytes, access_type type)
+ protected:
+  void access(uint64_t addr, size_t bytes, access_type type)
   {
-    if (type == LOAD || type == STORE) cache->access(addr, bytes, type == STORE);
+    cache->access(addr, bytes, type == STORE);
   }
 };
 
+// Runs the cache models off the simulation thread.  Tracers hand over their
+// accesses in batches; the models see each tracer's accesses in order, and
+// different tracers' (e.g. harts') interleaved a batch at a time.  Since
+// one thread runs all the models, a shared L2 and coherence between L1s need
+// no locking.
+class cache_sim_thread_t
+{
+ public:
+  cache_sim_thread_t();
+  // flushes the registered tracers and finishes all their accesses
+  ~cache_sim_thread_t();
+
+  void add_tracer(cache_memtracer_t* tracer) { tracers.push_back(tracer); }
+  void submit(cache_memtracer_t* tracer, std::vector<cache_access_t>&& batch);
+
+ private:
+  void main();
+
+  static const size_t MAX_QUEUED = 64;
+  std::vector<cache_memtracer_t*> tracers;
+  std::deque<std::pair<cache_memtracer_t*, std::vector<cache_access_t>>> queue;
+  std::mutex lock;
+  std::condition_variable queued;
+  std::condition_variable dequeued;
+  bool exiting;
+  std::thread thread;
+};
+
 #endif
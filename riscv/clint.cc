@@ -1,4 +1,5 @@
 #include <sys/time.h>
+#include <stdexcept>
 #include "devices.h"
 #include "processor.h"
 
@@ -87,3 +88,18 @@ void clint_t::increment(reg_t inc)
       procs[i]->state.mip->backdoor_write_with_mask(MIP_MTIP, MIP_MTIP);
   }
 }
+
+void clint_t::save_state(std::vector<reg_t>& out)
+{
+  out.push_back(mtime);
+  out.insert(out.end(), mtimecmp.begin(), mtimecmp.end());
+}
+
+void clint_t::restore_state(const reg_t*& pos, const reg_t* end)
+{
+  if (size_t(end - pos) < 1 + mtimecmp.size())
+    throw std::runtime_error("truncated CLINT state");
+  mtime = *pos++;
+  for (auto& cmp : mtimecmp)
+    cmp = *pos++;
+}
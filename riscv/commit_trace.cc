@@ -0,0 +1,565 @@
+// See LICENSE for license details.
+
+#include "commit_trace.h"
+#include "processor.h"
+#include "disasm.h"
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string.h>
+
+// File layout, in host byte order: an 8-byte magic and a 4-byte version,
+// then blocks.  Each block has a header of three 32-bit words -- the hart id,
+// the raw size and the compressed size (0 if the block is stored raw) -- and
+// then its data.
+//
+// A raw block is a sequence of records, one per retired instruction, and
+// decodes on its own: the encoder state below is reset at each block.
+//
+//   flags               priv (bits 0-1) and the TRACE_* bits
+//   xlen flen vlen      if TRACE_MODE (the first record of each block, or
+//                       after xlen/flen change)
+//   pc delta            if TRACE_PC, zigzag(pc - predicted pc), where the
+//                       prediction is the fall-through of the last record
+//   insn bits
+//   vsew lmul vl        if TRACE_VEC
+//   register writes     if TRACE_REGS: a count, then per write the commit
+//                       log key and the value (nothing for key type 3)
+//   loads               if TRACE_LOADS: a count, then zigzag address deltas
+//   stores              if TRACE_STORES: a count, then per store a zigzag
+//                       address delta, the size in bytes and the value
+//
+// Everything but the flags and the raw vector register contents is a
+// varint.
+
+static const char TRACE_MAGIC[8] = {'s', 'p', 'i', 'k', 'e', 't', 'r', 'c'};
+static const uint32_t TRACE_VERSION = 1;
+static const size_t TRACE_BLOCK_SIZE = 64 * 1024;
+
+#define TRACE_MODE   (1 << 2)
+#define TRACE_PC     (1 << 3)
+#define TRACE_VEC    (1 << 4)
+#define TRACE_REGS   (1 << 5)
+#define TRACE_LOADS  (1 << 6)
+#define TRACE_STORES (1 << 7)
+
+static void put_varint(std::vector<uint8_t>& b, uint64_t x)
+{
+  while (x >= 0x80) {
+    b.push_back(x | 0x80);
+    x >>= 7;
+  }
+  b.push_back(x);
+}
+
+static uint64_t zigzag(reg_t x)
+{
+  return (x << 1) ^ -(x >> 63);
+}
+
+static reg_t unzigzag(uint64_t x)
+{
+  return (x >> 1) ^ -(x & 1);
+}
+
+static uint64_t width_mask(int width)
+{
+  return width >= 64 ? UINT64_MAX : (UINT64_C(1) << width) - 1;
+}
+
+// A small LZ77 coder: a compressed block is a sequence of literal runs, each
+// followed by a match of at least 4 bytes; lengths and offsets are varints.
+static void lz_compress(const std::vector<uint8_t>& in, std::vector<uint8_t>& out)
+{
+  const int HASH_BITS = 14;
+  std::vector<uint32_t> table(1 << HASH_BITS, UINT32_MAX);
+  size_t lit = 0, i = 0;
+
+  while (i + 4 <= in.size()) {
+    uint32_t v;
+    memcpy(&v, &in[i], sizeof(v));
+    uint32_t h = (v * 2654435761U) >> (32 - HASH_BITS);
+    size_t cand = table[h];
+    table[h] = i;
+
+    if (cand == UINT32_MAX || memcmp(&in[cand], &in[i], 4) != 0) {
+      i++;
+      continue;
+    }
+
+    size_t len = 4;
+    while (i + len < in.size() && in[cand + len] == in[i + len])
+      len++;
+    put_varint(out, i - lit);
+    out.insert(out.end(), in.begin() + lit, in.begin() + i);
+    put_varint(out, len - 4);
+    put_varint(out, i - cand);
+    i += len;
+    lit = i;
+  }
+
+  put_varint(out, in.size() - lit);
+  out.insert(out.end(), in.begin() + lit, in.end());
+}
+
+commit_trace_stream_t::commit_trace_stream_t(commit_trace_t* trace, uint32_t hartid)
+  : trace(trace), hartid(hartid), block(NULL), ring_head(0), ring_tail(0)
+{
+  start_block();
+}
+
+commit_trace_stream_t::~commit_trace_stream_t()
+{
+  delete block;
+  for (size_t i = ring_tail; i != ring_head; i++)
+    delete ring[i % RING_SIZE];
+}
+
+void commit_trace_stream_t::start_block()
+{
+  block = new std::vector<uint8_t>;
+  block->reserve(TRACE_BLOCK_SIZE + 4096); // and the record that fills it
+  xlen = flen = 0;
+  next_pc = 0;
+  last_addr = 0;
+}
+
+void commit_trace_stream_t::publish_block()
+{
+  size_t head = ring_head.load(std::memory_order_relaxed);
+  while (head - ring_tail.load(std::memory_order_acquire) == RING_SIZE)
+    std::this_thread::yield(); // the writer is behind; wait for a free slot
+  ring[head % RING_SIZE] = block;
+  ring_head.store(head + 1, std::memory_order_release);
+  trace->writer_wakeup.notify_one();
+  start_block();
+}
+
+#ifdef RISCV_ENABLE_COMMITLOG
+void commit_trace_stream_t::record(processor_t* p, reg_t pc, insn_t insn)
+{
+  state_t* state = p->get_state();
+  auto& b = *block;
+  auto& regs = state->log_reg_write;
+  auto& loads = state->log_mem_read;
+  auto& stores = state->log_mem_write;
+
+  bool vec = false;
+  for (auto& item : regs)
+    vec |= (item.first & 0xf) == 2 || (item.first & 0xf) == 3;
+
+  uint8_t flags = state->last_inst_priv & 3;
+  if (state->last_inst_xlen != xlen || state->last_inst_flen != flen)
+    flags |= TRACE_MODE;
+  if (pc != next_pc)
+    flags |= TRACE_PC;
+  if (vec)
+    flags |= TRACE_VEC;
+  if (!regs.empty())
+    flags |= TRACE_REGS;
+  if (!loads.empty())
+    flags |= TRACE_LOADS;
+  if (!stores.empty())
+    flags |= TRACE_STORES;
+  b.push_back(flags);
+
+  if (flags & TRACE_MODE) {
+    xlen = state->last_inst_xlen;
+    flen = state->last_inst_flen;
+    put_varint(b, xlen);
+    put_varint(b, flen);
+    put_varint(b, p->VU.VLEN);
+  }
+
+  if (flags & TRACE_PC)
+    put_varint(b, zigzag(pc - next_pc));
+  put_varint(b, insn.bits());
+  next_pc = pc + insn.length();
+
+  if (vec) {
+    put_varint(b, p->VU.vsew);
+    put_varint(b, p->VU.vflmul < 1 ? reg_t(1 / p->VU.vflmul) << 1 | 1 : reg_t(p->VU.vflmul) << 1);
+    put_varint(b, p->VU.vl);
+  }
+
+  if (!regs.empty()) {
+    put_varint(b, regs.size());
+    for (auto& item : regs) {
+      put_varint(b, item.first);
+      switch (item.first & 0xf) {
+        case 0:
+        case 4:
+          put_varint(b, item.second.v[0] & width_mask(xlen));
+          break;
+        case 1:
+          put_varint(b, item.second.v[0] & width_mask(flen));
+          if (flen > 64)
+            put_varint(b, item.second.v[1]);
+          break;
+        case 2: {
+          const uint8_t* vreg = &p->VU.elt<uint8_t>(item.first >> 4, 0);
+          b.insert(b.end(), vreg, vreg + p->VU.VLEN / 8);
+          break;
+        }
+      }
+    }
+  }
+
+  if (!loads.empty()) {
+    put_varint(b, loads.size());
+    for (auto& item : loads) {
+      put_varint(b, zigzag(std::get<0>(item) - last_addr));
+      last_addr = std::get<0>(item);
+    }
+  }
+
+  if (!stores.empty()) {
+    put_varint(b, stores.size());
+    for (auto& item : stores) {
+      put_varint(b, zigzag(std::get<0>(item) - last_addr));
+      last_addr = std::get<0>(item);
+      b.push_back(std::get<2>(item));
+      put_varint(b, std::get<1>(item) & width_mask(std::get<2>(item) * 8));
+    }
+  }
+
+  if (b.size() >= TRACE_BLOCK_SIZE)
+    publish_block();
+}
+#endif
+
+commit_trace_t::commit_trace_t(const char* path)
+  : path(path), failed(false), writer_exit(false)
+{
+  file = fopen(path, "wb");
+  if (!file)
+    throw std::runtime_error(std::string("can't open commit trace ") + path + ": " + strerror(errno));
+
+  uint32_t version = TRACE_VERSION;
+  write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+  write(&version, sizeof(version));
+
+  writer = std::thread(&commit_trace_t::writer_main, this);
+}
+
+commit_trace_t::~commit_trace_t()
+{
+  // the harts have stopped; hand over what they have left
+  for (auto& s : streams)
+    if (!s->block->empty())
+      s->publish_block();
+
+  writer_exit = true;
+  writer_wakeup.notify_one();
+  writer.join();
+  if (fflush(file) != 0 || ferror(file))
+    report_error(errno);
+  if (fclose(file) != 0)
+    report_error(errno);
+}
+
+void commit_trace_t::report_error(int err)
+{
+  if (!failed)
+    std::cerr << "can't write commit trace " << path << ": " << strerror(err) << std::endl;
+  failed = true;
+}
+
+void commit_trace_t::write(const void* data, size_t len)
+{
+  if (!failed && fwrite(data, 1, len, file) != len)
+    report_error(errno);
+}
+
+commit_trace_stream_t* commit_trace_t::stream(uint32_t hartid)
+{
+  std::lock_guard<std::mutex> lock(writer_lock);
+  streams.emplace_back(new commit_trace_stream_t(this, hartid));
+  return streams.back().get();
+}
+
+void commit_trace_t::write_block(uint32_t hartid, const std::vector<uint8_t>& raw)
+{
+  std::vector<uint8_t> compressed;
+  compressed.reserve(raw.size());
+  lz_compress(raw, compressed);
+  bool stored = compressed.size() >= raw.size();
+  const std::vector<uint8_t>& data = stored ? raw : compressed;
+
+  uint32_t header[3] = {hartid, uint32_t(raw.size()), stored ? 0 : uint32_t(compressed.size())};
+  write(header, sizeof(header));
+  write(data.data(), data.size());
+}
+
+void commit_trace_t::writer_main()
+{
+  std::unique_lock<std::mutex> lock(writer_lock);
+  while (true) {
+    // Check for exit before draining, so blocks published before the exit
+    // request are always written.
+    bool exiting = writer_exit;
+    bool idle = true;
+
+    for (auto& s : streams) {
+      size_t tail = s->ring_tail.load(std::memory_order_relaxed);
+      while (tail != s->ring_head.load(std::memory_order_acquire)) {
+        std::vector<uint8_t>* block = s->ring[tail % s->RING_SIZE];
+        write_block(s->hartid, *block);
+        delete block;
+        s->ring_tail.store(++tail, std::memory_order_release);
+        idle = false;
+      }
+    }
+
+    if (idle) {
+      if (exiting)
+        break;
+      // producers notify without the lock, so don't rely on every wakeup
+      writer_wakeup.wait_for(lock, std::chrono::milliseconds(10));
+    }
+  }
+}
+
+void commit_log_print_value(FILE *log_file, int width, const void *data)
+{
+  assert(log_file);
+
+  switch (width) {
+    case 8:
+      fprintf(log_file, "0x%01" PRIx8, *(const uint8_t *)data);
+      break;
+    case 16:
+      fprintf(log_file, "0x%04" PRIx16, *(const uint16_t *)data);
+      break;
+    case 32:
+      fprintf(log_file, "0x%08" PRIx32, *(const uint32_t *)data);
+      break;
+    case 64:
+      fprintf(log_file, "0x%016" PRIx64, *(const uint64_t *)data);
+      break;
+    default:
+      // max lengh of vector
+      if (((width - 1) & width) == 0) {
+        const uint64_t *arr = (const uint64_t *)data;
+
+        fprintf(log_file, "0x");
+        for (int idx = width / 64 - 1; idx >= 0; --idx) {
+          fprintf(log_file, "%016" PRIx64, arr[idx]);
+        }
+      } else {
+        abort();
+      }
+      break;
+  }
+}
+
+// Reads one decoded block.
+class trace_block_reader_t
+{
+ public:
+  trace_block_reader_t(const std::vector<uint8_t>& data) : pos(data.data()), end(pos + data.size()) {}
+
+  bool done() const { return pos == end; }
+
+  uint8_t byte()
+  {
+    if (pos == end)
+      throw std::runtime_error("truncated commit trace record");
+    return *pos++;
+  }
+
+  uint64_t varint()
+  {
+    uint64_t x = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      uint8_t b = byte();
+      x |= uint64_t(b & 0x7f) << shift;
+      if (!(b & 0x80))
+        return x;
+    }
+    throw std::runtime_error("bad varint in commit trace");
+  }
+
+  const uint8_t* bytes(size_t n)
+  {
+    if (size_t(end - pos) < n)
+      throw std::runtime_error("truncated commit trace record");
+    pos += n;
+    return pos - n;
+  }
+
+ private:
+  const uint8_t* pos;
+  const uint8_t* end;
+};
+
+static void lz_decompress(const std::vector<uint8_t>& in, size_t raw_size, std::vector<uint8_t>& out)
+{
+  trace_block_reader_t r(in);
+  out.clear();
+  out.reserve(raw_size);
+  while (true) {
+    size_t lit = r.varint();
+    if (lit > raw_size - out.size())
+      throw std::runtime_error("bad literal run in commit trace");
+    const uint8_t* p = r.bytes(lit);
+    out.insert(out.end(), p, p + lit);
+    if (out.size() == raw_size)
+      break;
+
+    size_t len = r.varint() + 4;
+    size_t offset = r.varint();
+    if (offset == 0 || offset > out.size() || len > raw_size - out.size())
+      throw std::runtime_error("bad match in commit trace");
+    for (size_t i = 0; i < len; i++)
+      out.push_back(out[out.size() - offset]);
+  }
+}
+
+static void decode_block(uint32_t hartid, const std::vector<uint8_t>& data, FILE* out)
+{
+  trace_block_reader_t r(data);
+  int xlen = 0, flen = 0;
+  reg_t vlen = 0;
+  reg_t next_pc = 0, last_addr = 0;
+  std::vector<uint64_t> vreg;
+
+  while (!r.done()) {
+    uint8_t flags = r.byte();
+    if (flags & TRACE_MODE) {
+      xlen = r.varint();
+      flen = r.varint();
+      vlen = r.varint();
+    }
+    if (!xlen)
+      throw std::runtime_error("commit trace block doesn't start with a mode record");
+
+    reg_t pc = next_pc;
+    if (flags & TRACE_PC)
+      pc += unzigzag(r.varint());
+    uint64_t bits = r.varint();
+    next_pc = pc + insn_length(bits);
+
+    reg_t vsew = 0, lmul = 0, vl = 0;
+    if (flags & TRACE_VEC) {
+      vsew = r.varint();
+      lmul = r.varint();
+      vl = r.varint();
+    }
+
+    fprintf(out, "core%4" PRId32 ": ", hartid);
+    fprintf(out, "%1d ", flags & 3);
+    commit_log_print_value(out, xlen, &pc);
+    fprintf(out, " (");
+    commit_log_print_value(out, insn_length(bits) * 8, &bits);
+    fprintf(out, ")");
+    bool show_vec = false;
+
+    size_t nregs = flags & TRACE_REGS ? r.varint() : 0;
+    for (size_t i = 0; i < nregs; i++) {
+      reg_t key = r.varint();
+      int rd = key >> 4;
+      uint64_t value[2] = {0, 0};
+      const void* data = value;
+      char prefix = 0;
+      int size = 0;
+      switch (key & 0xf) {
+        case 0:
+          size = xlen;
+          prefix = 'x';
+          value[0] = r.varint();
+          break;
+        case 1:
+          size = flen;
+          prefix = 'f';
+          value[0] = r.varint();
+          if (flen > 64)
+            value[1] = r.varint();
+          break;
+        case 2:
+          size = vlen;
+          prefix = 'v';
+          vreg.resize((vlen + 63) / 64);
+          memcpy(vreg.data(), r.bytes(vlen / 8), vlen / 8);
+          data = vreg.data();
+          break;
+        case 3:
+          break;
+        case 4:
+          size = xlen;
+          prefix = 'c';
+          value[0] = r.varint();
+          break;
+        default:
+          throw std::runtime_error("bad register in commit trace");
+      }
+
+      if (key == 0)
+        continue;
+
+      bool is_vec = (key & 0xf) == 3;
+      if (!show_vec && (is_vec || (key & 0xf) == 2)) {
+        fprintf(out, " e%ld %s%ld l%ld", (long)vsew, lmul & 1 ? "mf" : "m",
+                (long)(lmul >> 1), (long)vl);
+        show_vec = true;
+      }
+
+      if (!is_vec) {
+        if (prefix == 'c')
+          fprintf(out, " c%d_%s ", rd, csr_name(rd));
+        else
+          fprintf(out, " %c%2d ", prefix, rd);
+        commit_log_print_value(out, size, data);
+      }
+    }
+
+    size_t nloads = flags & TRACE_LOADS ? r.varint() : 0;
+    for (size_t i = 0; i < nloads; i++) {
+      last_addr += unzigzag(r.varint());
+      fprintf(out, " mem ");
+      commit_log_print_value(out, xlen, &last_addr);
+    }
+
+    size_t nstores = flags & TRACE_STORES ? r.varint() : 0;
+    for (size_t i = 0; i < nstores; i++) {
+      last_addr += unzigzag(r.varint());
+      uint8_t size = r.byte();
+      uint64_t value = r.varint();
+      fprintf(out, " mem ");
+      commit_log_print_value(out, xlen, &last_addr);
+      fprintf(out, " ");
+      commit_log_print_value(out, size << 3, &value);
+    }
+    fprintf(out, "\n");
+  }
+}
+
+void commit_trace_decode(FILE* in, FILE* out)
+{
+  char magic[sizeof(TRACE_MAGIC)];
+  uint32_t version;
+  if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) ||
+      memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0 ||
+      fread(&version, sizeof(version), 1, in) != 1)
+    throw std::runtime_error("not a commit trace");
+  if (version != TRACE_VERSION)
+    throw std::runtime_error("unsupported commit trace version " + std::to_string(version));
+
+  std::vector<uint8_t> data, raw;
+  uint32_t header[3];
+  while (fread(header, sizeof(header), 1, in) == 1) {
+    size_t raw_size = header[1], compressed_size = header[2];
+    data.resize(compressed_size ? compressed_size : raw_size);
+    if (fread(data.data(), 1, data.size(), in) != data.size())
+      throw std::runtime_error("truncated commit trace block");
+    if (compressed_size) {
+      lz_decompress(data, raw_size, raw);
+      decode_block(header[0], raw, out);
+    } else {
+      decode_block(header[0], data, out);
+    }
+  }
+}
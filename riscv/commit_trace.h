@@ -0,0 +1,88 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_COMMIT_TRACE_H
+#define _RISCV_COMMIT_TRACE_H
+
+#include "decode.h"
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class processor_t;
+
+// A compact binary form of the commit log.  Each hart encodes its retired
+// instructions into blocks of varint-coded records, with PCs and memory
+// addresses given as deltas; full blocks are handed through a lock-free ring
+// to a writer thread, which compresses them and writes them to the file.
+// commit_trace_decode turns a trace back into the --log-commits text.
+
+// Print a value in the commit log's text format.
+void commit_log_print_value(FILE *log_file, int width, const void *data);
+
+// Write a binary trace as commit log text.  Throws std::runtime_error if the
+// trace is malformed.
+void commit_trace_decode(FILE* in, FILE* out);
+
+class commit_trace_stream_t
+{
+ public:
+  commit_trace_stream_t(class commit_trace_t* trace, uint32_t hartid);
+  ~commit_trace_stream_t();
+
+  // record the instruction the hart just retired
+  void record(processor_t* p, reg_t pc, insn_t insn);
+
+ private:
+  friend class commit_trace_t;
+
+  void start_block();
+  void publish_block();
+
+  commit_trace_t* trace;
+  uint32_t hartid;
+
+  // the block being filled, and the encoder state it's relative to
+  std::vector<uint8_t>* block;
+  int xlen, flen;
+  reg_t next_pc;
+  reg_t last_addr;
+
+  // single-producer, single-consumer ring of full blocks
+  static const size_t RING_SIZE = 16;
+  std::vector<uint8_t>* ring[RING_SIZE];
+  std::atomic<size_t> ring_head;
+  std::atomic<size_t> ring_tail;
+};
+
+class commit_trace_t
+{
+ public:
+  commit_trace_t(const char* path);
+  ~commit_trace_t();
+
+  commit_trace_stream_t* stream(uint32_t hartid);
+
+ private:
+  friend class commit_trace_stream_t;
+
+  void writer_main();
+  void write_block(uint32_t hartid, const std::vector<uint8_t>& raw);
+  void write(const void* data, size_t len);
+  void report_error(int err);
+
+  std::string path;
+  FILE* file;
+  bool failed; // an error was reported, and the rest of the trace is dropped
+  std::vector<std::unique_ptr<commit_trace_stream_t>> streams;
+  std::thread writer;
+  std::mutex writer_lock;
+  std::condition_variable writer_wakeup;
+  std::atomic<bool> writer_exit;
+};
+
+#endif
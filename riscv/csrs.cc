@@ -53,6 +53,13 @@ void csr_t::log_write() const noexcept {
 #endif
 }
 
+std::vector<reg_t> csr_t::save_raw() const {
+  return {};
+}
+
+void csr_t::restore_raw(const std::vector<reg_t>& raw) noexcept {
+}
+
 // implement class basic_csr_t
 basic_csr_t::basic_csr_t(processor_t* const proc, const reg_t addr, const reg_t init):
   csr_t(proc, addr),
@@ -63,6 +70,14 @@ reg_t basic_csr_t::read() const noexcept {
   return val;
 }
 
+std::vector<reg_t> basic_csr_t::save_raw() const {
+  return {val};
+}
+
+void basic_csr_t::restore_raw(const std::vector<reg_t>& raw) noexcept {
+  val = raw[0];
+}
+
 bool basic_csr_t::unlogged_write(const reg_t val) noexcept {
   this->val = val;
   return true;
@@ -95,6 +110,15 @@ reg_t pmpaddr_csr_t::read() const noexcept {
   return val & proc->pmp_tor_mask();
 }
 
+std::vector<reg_t> pmpaddr_csr_t::save_raw() const {
+  return {val, cfg};
+}
+
+void pmpaddr_csr_t::restore_raw(const std::vector<reg_t>& raw) noexcept {
+  val = raw[0];
+  cfg = raw[1];
+}
+
 
 bool pmpaddr_csr_t::unlogged_write(const reg_t val) noexcept {
   // If no PMPs are configured, disallow access to all. Otherwise,
@@ -228,6 +252,15 @@ reg_t virtualized_csr_t::read() const noexcept {
   return readvirt(state->v);
 }
 
+// The virtual CSR has its own csrmap entry, so only the original is saved here.
+std::vector<reg_t> virtualized_csr_t::save_raw() const {
+  return orig_csr->save_raw();
+}
+
+void virtualized_csr_t::restore_raw(const std::vector<reg_t>& raw) noexcept {
+  orig_csr->restore_raw(raw);
+}
+
 reg_t virtualized_csr_t::readvirt(bool virt) const noexcept {
   return virt ? virt_csr->read() : orig_csr->read();
 }
@@ -252,6 +285,14 @@ reg_t epc_csr_t::read() const noexcept {
   return val & proc->pc_alignment_mask();
 }
 
+std::vector<reg_t> epc_csr_t::save_raw() const {
+  return {val};
+}
+
+void epc_csr_t::restore_raw(const std::vector<reg_t>& raw) noexcept {
+  val = raw[0];
+}
+
 
 bool epc_csr_t::unlogged_write(const reg_t val) noexcept {
   this->val = val & ~(reg_t)1;
@@ -270,6 +311,14 @@ reg_t tvec_csr_t::read() const noexcept {
   return val;
 }
 
+std::vector<reg_t> tvec_csr_t::save_raw() const {
+  return {val};
+}
+
+void tvec_csr_t::restore_raw(const std::vector<reg_t>& raw) noexcept {
+  val = raw[0];
+}
+
 
 bool tvec_csr_t::unlogged_write(const reg_t val) noexcept {
   this->val = val & ~(reg_t)2;
@@ -337,11 +386,12 @@ reg_t base_status_csr_t::adjust_sd(const reg_t val) const noexcept {
 
 
 void base_status_csr_t::maybe_flush_tlb(const reg_t newval) noexcept {
-  if ((newval ^ read()) &
-      (MSTATUS_MPP | MSTATUS_MPRV
-       | (has_page ? (MSTATUS_MXR | MSTATUS_SUM) : 0)
-      ))
+  // MPP only affects translation while MPRV is set, and the TLB isn't refilled
+  // then, so traps and xRETs that just update MPP needn't flush it.
+  if ((newval ^ read()) & (MSTATUS_MPRV | ((newval & MSTATUS_MPRV) ? MSTATUS_MPP : 0)))
     proc->get_mmu()->flush_tlb();
+  else if ((newval ^ read()) & (has_page ? (MSTATUS_MXR | MSTATUS_SUM) : 0))
+    proc->get_mmu()->invalidate_tlb_context();
 }
 
 
@@ -366,6 +416,14 @@ reg_t vsstatus_csr_t::read() const noexcept {
   return val;
 }
 
+std::vector<reg_t> vsstatus_csr_t::save_raw() const {
+  return {val};
+}
+
+void vsstatus_csr_t::restore_raw(const std::vector<reg_t>& raw) noexcept {
+  val = raw[0];
+}
+
 bool vsstatus_csr_t::unlogged_write(const reg_t val) noexcept {
   const reg_t newval = (this->val & ~sstatus_write_mask) | (val & sstatus_write_mask);
   if (state->v) maybe_flush_tlb(newval);
@@ -410,6 +468,14 @@ reg_t mstatus_csr_t::read() const noexcept {
   return val;
 }
 
+std::vector<reg_t> mstatus_csr_t::save_raw() const {
+  return {val};
+}
+
+void mstatus_csr_t::restore_raw(const std::vector<reg_t>& raw) noexcept {
+  val = raw[0];
+}
+
 
 bool mstatus_csr_t::unlogged_write(const reg_t val) noexcept {
   const bool has_mpv = proc->extension_enabled('S') && proc->extension_enabled('H');
@@ -436,6 +502,14 @@ sstatus_csr_t::sstatus_csr_t(processor_t* const proc, csr_t_p orig, csr_t_p virt
 }
 
 void sstatus_csr_t::dirty(const reg_t dirties) {
+#ifndef RISCV_ENABLE_COMMITLOG
+  // Nearly every FP and vector instruction gets here with its state already
+  // dirty, so skip the status register writes unless something changes.
+  // Commit logs keep recording the write every time.
+  if ((orig_csr->read() & dirties) == dirties &&
+      (!state->v || (virt_csr->read() & dirties) == dirties))
+    return;
+#endif
   orig_csr->write(orig_csr->read() | dirties);
   if (state->v) {
     virt_csr->write(virt_csr->read() | dirties);
@@ -520,11 +594,25 @@ reg_t mip_or_mie_csr_t::read() const noexcept {
   return val;
 }
 
+std::vector<reg_t> mip_or_mie_csr_t::save_raw() const {
+  return {val};
+}
+
+void mip_or_mie_csr_t::restore_raw(const std::vector<reg_t>& raw) noexcept {
+  val = raw[0];
+}
+
 void mip_or_mie_csr_t::write_with_mask(const reg_t mask, const reg_t val) noexcept {
-  this->val = (this->val & ~mask) | (val & mask);
+  update_with_mask(mask, val);
   log_write();
 }
 
+void mip_or_mie_csr_t::update_with_mask(const reg_t mask, const reg_t val) noexcept {
+  reg_t old = this->val.load();
+  while (!this->val.compare_exchange_weak(old, (old & ~mask) | (val & mask)))
+    ;
+}
+
 bool mip_or_mie_csr_t::unlogged_write(const reg_t val) noexcept {
   write_with_mask(write_mask(), val);
   return false; // avoid double logging: already logged by write_with_mask()
@@ -536,7 +624,7 @@ mip_csr_t::mip_csr_t(processor_t* const proc, const reg_t addr):
 }
 
 void mip_csr_t::backdoor_write_with_mask(const reg_t mask, const reg_t val) noexcept {
-  this->val = (this->val & ~mask) | (val & mask);
+  update_with_mask(mask, val);
 }
 
 reg_t mip_csr_t::write_mask() const noexcept {
@@ -734,7 +822,7 @@ base_atp_csr_t::base_atp_csr_t(processor_t* const proc, const reg_t addr):
 bool base_atp_csr_t::unlogged_write(const reg_t val) noexcept {
   const reg_t newval = proc->supports_impl(IMPL_MMU) ? compute_new_satp(val) : 0;
   if (newval != read())
-    proc->get_mmu()->flush_tlb();
+    proc->get_mmu()->invalidate_tlb_context();
   return basic_csr_t::unlogged_write(newval);
 }
 
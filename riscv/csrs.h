@@ -6,6 +6,10 @@
 #include "decode.h"
 // For std::shared_ptr
 #include <memory>
+// For std::atomic
+#include <atomic>
+// For std::vector
+#include <vector>
 // For access_type:
 #include "memtracer.h"
 
@@ -29,6 +33,12 @@ class csr_t {
   // Child classes must implement unlogged_write()
   void write(const reg_t val) noexcept;
 
+  // For checkpoints: the raw state this CSR holds, which restore_raw() puts
+  // back as is, without legalizing it or applying write() side effects.
+  // CSRs that are only views of other CSRs' state hold none.
+  virtual std::vector<reg_t> save_raw() const;
+  virtual void restore_raw(const std::vector<reg_t>& raw) noexcept;
+
   virtual ~csr_t();
 
  protected:
@@ -55,6 +65,8 @@ class basic_csr_t: public csr_t {
  public:
   basic_csr_t(processor_t* const proc, const reg_t addr, const reg_t init);
   virtual reg_t read() const noexcept override;
+  virtual std::vector<reg_t> save_raw() const override;
+  virtual void restore_raw(const std::vector<reg_t>& raw) noexcept override;
  protected:
   virtual bool unlogged_write(const reg_t val) noexcept override;
  private:
@@ -67,6 +79,8 @@ class pmpaddr_csr_t: public csr_t {
   pmpaddr_csr_t(processor_t* const proc, const reg_t addr);
   virtual void verify_permissions(insn_t insn, bool write) const override;
   virtual reg_t read() const noexcept override;
+  virtual std::vector<reg_t> save_raw() const override;
+  virtual void restore_raw(const std::vector<reg_t>& raw) noexcept override;
 
   // Does a 4-byte access at the specified address match this PMP entry?
   bool match4(reg_t addr) const noexcept;
@@ -124,6 +138,8 @@ class virtualized_csr_t: public csr_t {
   virtualized_csr_t(processor_t* const proc, csr_t_p orig, csr_t_p virt);
 
   virtual reg_t read() const noexcept override;
+  virtual std::vector<reg_t> save_raw() const override;
+  virtual void restore_raw(const std::vector<reg_t>& raw) noexcept override;
   // Instead of using state.v, explicitly request original or virtual:
   reg_t readvirt(bool virt) const noexcept;
  protected:
@@ -140,6 +156,8 @@ class epc_csr_t: public csr_t {
   epc_csr_t(processor_t* const proc, const reg_t addr);
 
   virtual reg_t read() const noexcept override;
+  virtual std::vector<reg_t> save_raw() const override;
+  virtual void restore_raw(const std::vector<reg_t>& raw) noexcept override;
  protected:
   virtual bool unlogged_write(const reg_t val) noexcept override;
  private:
@@ -153,6 +171,8 @@ class tvec_csr_t: public csr_t {
   tvec_csr_t(processor_t* const proc, const reg_t addr);
 
   virtual reg_t read() const noexcept override;
+  virtual std::vector<reg_t> save_raw() const override;
+  virtual void restore_raw(const std::vector<reg_t>& raw) noexcept override;
  protected:
   virtual bool unlogged_write(const reg_t val) noexcept override;
  private:
@@ -190,6 +210,8 @@ class vsstatus_csr_t: public base_status_csr_t {
  public:
   vsstatus_csr_t(processor_t* const proc, const reg_t addr);
   virtual reg_t read() const noexcept override;
+  virtual std::vector<reg_t> save_raw() const override;
+  virtual void restore_raw(const std::vector<reg_t>& raw) noexcept override;
  protected:
   virtual bool unlogged_write(const reg_t val) noexcept override;
  private:
@@ -214,6 +236,8 @@ class mstatus_csr_t: public base_status_csr_t {
  public:
   mstatus_csr_t(processor_t* const proc, const reg_t addr);
   virtual reg_t read() const noexcept override;
+  virtual std::vector<reg_t> save_raw() const override;
+  virtual void restore_raw(const std::vector<reg_t>& raw) noexcept override;
  protected:
   virtual bool unlogged_write(const reg_t val) noexcept override;
  private:
@@ -255,12 +279,17 @@ class mip_or_mie_csr_t: public csr_t {
  public:
   mip_or_mie_csr_t(processor_t* const proc, const reg_t addr);
   virtual reg_t read() const noexcept override final;
+  virtual std::vector<reg_t> save_raw() const override;
+  virtual void restore_raw(const std::vector<reg_t>& raw) noexcept override;
 
   void write_with_mask(const reg_t mask, const reg_t val) noexcept;
 
  protected:
   virtual bool unlogged_write(const reg_t val) noexcept override final;
-  reg_t val;
+  void update_with_mask(const reg_t mask, const reg_t val) noexcept;
+  // Harts running on other host threads may set bits in mip (e.g. via the
+  // CLINT), so updates must be atomic.
+  std::atomic<reg_t> val;
  private:
   virtual reg_t write_mask() const noexcept = 0;
 };
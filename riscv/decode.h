@@ -345,12 +345,18 @@ private:
        STATE.pc = __npc; \
      } while(0)
 
-class wait_for_interrupt_t {};
-
+/* WFI ends the step, returning to the outer simulation loop so other
+   devices and harts get a chance to raise interrupts. */
 #define wfi() \
   do { set_pc_and_serialize(npc); \
        npc = PC_SERIALIZE_WFI; \
-       throw wait_for_interrupt_t(); \
+     } while(0)
+
+/* Raise one of the common traps (see processor_t::take_returned_trap) by
+   returning a sentinel PC, which is much cheaper than throwing. */
+#define return_trap(cause) \
+  do { STATE.returned_trap = (cause); \
+       npc = PC_TRAP; \
      } while(0)
 
 #define serialize() set_pc_and_serialize(npc)
@@ -359,6 +365,7 @@ class wait_for_interrupt_t {};
 #define PC_SERIALIZE_BEFORE 3
 #define PC_SERIALIZE_AFTER 5
 #define PC_SERIALIZE_WFI 7
+#define PC_TRAP 9
 #define invalid_pc(pc) ((pc) & 1)
 
 /* Convenience wrappers to simplify softfloat code sequences */
@@ -655,6 +662,13 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
 //
 // vector: loop header and end helper
 //
+// The operand register groups, set up once per instruction so that the
+// loops index their elements directly.
+#define VI_GROUP_VIEWS \
+  const auto vd_group = P.VU.group(rd_num); \
+  const auto vs1_group = P.VU.group(rs1_num); \
+  const auto vs2_group = P.VU.group(rs2_num)
+
 #define VI_GENERAL_LOOP_BASE \
   require(P.VU.vsew >= e8 && P.VU.vsew <= e64); \
   require_vector(true);\
@@ -663,6 +677,7 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
   reg_t rd_num = insn.rd(); \
   reg_t rs1_num = insn.rs1(); \
   reg_t rs2_num = insn.rs2(); \
+  VI_GROUP_VIEWS; \
   for (reg_t i=P.VU.vstart; i<vl; ++i){ 
 
 #define VI_LOOP_BASE \
@@ -673,6 +688,95 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
   } \
   P.VU.vstart = 0;
 
+//
+// vector: contiguous loops
+//
+// Unmasked VV/VX/VI loops access the register groups directly instead of
+// looking up each element with elt.  Whole chunks of elements are staged
+// through local arrays so the compiler can vectorize BODY; the rest are done
+// one by one.  The operand groups are either the same or disjoint, so this
+// gives the same result.  Big-endian hosts don't store elements in order, so
+// they always take the element-by-element loop.
+#ifdef WORDS_BIGENDIAN
+#define VI_CAN_LOOP_CONTIGUOUS false
+#else
+#define VI_CAN_LOOP_CONTIGUOUS (insn.v_vm() == 1)
+#endif
+
+#define VI_CONTIGUOUS_CHUNK_BYTES 32
+
+#define VV_CONTIGUOUS_GROUP \
+  const elt_t* vs1_group = P.VU.elt_group<elt_t>(rs1_num, vstart, vl);
+#define VV_CONTIGUOUS_CHUNK \
+  elt_t vs1_chunk[chunk]; \
+  memcpy(vs1_chunk, vs1_group + i, sizeof(vs1_chunk));
+#define VV_CONTIGUOUS_CHUNK_ELT \
+  elt_t vs1 = vs1_chunk[j];
+#define VV_CONTIGUOUS_ELT \
+  elt_t vs1 = vs1_group[i];
+
+#define VX_CONTIGUOUS_GROUP \
+  const elt_t rs1 = (elt_t)RS1;
+#define VX_CONTIGUOUS_CHUNK
+#define VX_CONTIGUOUS_CHUNK_ELT
+#define VX_CONTIGUOUS_ELT
+
+#define VI_CONTIGUOUS_GROUP \
+  const elt_t simm5 = (elt_t)insn.v_simm5();
+#define VI_CONTIGUOUS_CHUNK
+#define VI_CONTIGUOUS_CHUNK_ELT
+#define VI_CONTIGUOUS_ELT
+
+#define VI_CONTIGUOUS_LOOP_SEW(x, KIND, BODY) \
+  { \
+    typedef type_sew_t<x>::type elt_t; \
+    const reg_t chunk = VI_CONTIGUOUS_CHUNK_BYTES / sizeof(elt_t); \
+    elt_t* vd_group = P.VU.elt_group<elt_t>(rd_num, vstart, vl, true); \
+    const elt_t* vs2_group = P.VU.elt_group<elt_t>(rs2_num, vstart, vl); \
+    KIND##_CONTIGUOUS_GROUP \
+    reg_t i = vstart; \
+    for (; i + chunk <= vl; i += chunk) { \
+      elt_t vd_chunk[chunk], vs2_chunk[chunk]; \
+      memcpy(vd_chunk, vd_group + i, sizeof(vd_chunk)); \
+      memcpy(vs2_chunk, vs2_group + i, sizeof(vs2_chunk)); \
+      KIND##_CONTIGUOUS_CHUNK \
+      for (reg_t j = 0; j < chunk; ++j) { \
+        elt_t &vd = vd_chunk[j]; \
+        elt_t vs2 = vs2_chunk[j]; \
+        KIND##_CONTIGUOUS_CHUNK_ELT \
+        BODY; \
+      } \
+      memcpy(vd_group + i, vd_chunk, sizeof(vd_chunk)); \
+    } \
+    for (; i < vl; ++i) { \
+      elt_t &vd = vd_group[i]; \
+      elt_t vs2 = vs2_group[i]; \
+      KIND##_CONTIGUOUS_ELT \
+      BODY; \
+    } \
+  }
+
+#define VI_CONTIGUOUS_LOOP(KIND, BODY) \
+  require(P.VU.vsew >= e8 && P.VU.vsew <= e64); \
+  require_vector(true); \
+  reg_t vl = P.VU.vl; \
+  reg_t vstart = P.VU.vstart; \
+  reg_t sew = P.VU.vsew; \
+  reg_t rd_num = insn.rd(); \
+  reg_t rs1_num = insn.rs1(); \
+  reg_t rs2_num = insn.rs2(); \
+  if (vstart < vl) { \
+    if (sew == e8) \
+      VI_CONTIGUOUS_LOOP_SEW(e8, KIND, BODY) \
+    else if (sew == e16) \
+      VI_CONTIGUOUS_LOOP_SEW(e16, KIND, BODY) \
+    else if (sew == e32) \
+      VI_CONTIGUOUS_LOOP_SEW(e32, KIND, BODY) \
+    else if (sew == e64) \
+      VI_CONTIGUOUS_LOOP_SEW(e64, KIND, BODY) \
+  } \
+  P.VU.vstart = 0;
+
 #define VI_LOOP_REDUCTION_END(x) \
   } \
   if (vl > 0) { \
@@ -688,6 +792,7 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
   reg_t rd_num = insn.rd(); \
   reg_t rs1_num = insn.rs1(); \
   reg_t rs2_num = insn.rs2(); \
+  VI_GROUP_VIEWS; \
   for (reg_t i=P.VU.vstart; i<vl; ++i){ \
     VI_LOOP_ELEMENT_SKIP(); \
     uint64_t mmask = UINT64_C(1) << mpos; \
@@ -748,116 +853,116 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
 // vector: integer and masking operand access helper
 //
 #define VXI_PARAMS(x) \
-  type_sew_t<x>::type &vd = P.VU.elt<type_sew_t<x>::type>(rd_num, i, true); \
-  type_sew_t<x>::type vs1 = P.VU.elt<type_sew_t<x>::type>(rs1_num, i); \
-  type_sew_t<x>::type vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i); \
+  type_sew_t<x>::type &vd = vd_group.elt<type_sew_t<x>::type>(i, true); \
+  type_sew_t<x>::type vs1 = vs1_group.elt<type_sew_t<x>::type>(i); \
+  type_sew_t<x>::type vs2 = vs2_group.elt<type_sew_t<x>::type>(i); \
   type_sew_t<x>::type rs1 = (type_sew_t<x>::type)RS1; \
   type_sew_t<x>::type simm5 = (type_sew_t<x>::type)insn.v_simm5();
 
 #define VV_U_PARAMS(x) \
-  type_usew_t<x>::type &vd = P.VU.elt<type_usew_t<x>::type>(rd_num, i, true); \
-  type_usew_t<x>::type vs1 = P.VU.elt<type_usew_t<x>::type>(rs1_num, i); \
-  type_usew_t<x>::type vs2 = P.VU.elt<type_usew_t<x>::type>(rs2_num, i);
+  type_usew_t<x>::type &vd = vd_group.elt<type_usew_t<x>::type>(i, true); \
+  type_usew_t<x>::type vs1 = vs1_group.elt<type_usew_t<x>::type>(i); \
+  type_usew_t<x>::type vs2 = vs2_group.elt<type_usew_t<x>::type>(i);
 
 #define VX_U_PARAMS(x) \
-  type_usew_t<x>::type &vd = P.VU.elt<type_usew_t<x>::type>(rd_num, i, true); \
+  type_usew_t<x>::type &vd = vd_group.elt<type_usew_t<x>::type>(i, true); \
   type_usew_t<x>::type rs1 = (type_usew_t<x>::type)RS1; \
-  type_usew_t<x>::type vs2 = P.VU.elt<type_usew_t<x>::type>(rs2_num, i);
+  type_usew_t<x>::type vs2 = vs2_group.elt<type_usew_t<x>::type>(i);
 
 #define VI_U_PARAMS(x) \
-  type_usew_t<x>::type &vd = P.VU.elt<type_usew_t<x>::type>(rd_num, i, true); \
+  type_usew_t<x>::type &vd = vd_group.elt<type_usew_t<x>::type>(i, true); \
   type_usew_t<x>::type zimm5 = (type_usew_t<x>::type)insn.v_zimm5(); \
-  type_usew_t<x>::type vs2 = P.VU.elt<type_usew_t<x>::type>(rs2_num, i);
+  type_usew_t<x>::type vs2 = vs2_group.elt<type_usew_t<x>::type>(i);
 
 #define VV_PARAMS(x) \
-  type_sew_t<x>::type &vd = P.VU.elt<type_sew_t<x>::type>(rd_num, i, true); \
-  type_sew_t<x>::type vs1 = P.VU.elt<type_sew_t<x>::type>(rs1_num, i); \
-  type_sew_t<x>::type vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i);
+  type_sew_t<x>::type &vd = vd_group.elt<type_sew_t<x>::type>(i, true); \
+  type_sew_t<x>::type vs1 = vs1_group.elt<type_sew_t<x>::type>(i); \
+  type_sew_t<x>::type vs2 = vs2_group.elt<type_sew_t<x>::type>(i);
 
 #define VX_PARAMS(x) \
-  type_sew_t<x>::type &vd = P.VU.elt<type_sew_t<x>::type>(rd_num, i, true); \
+  type_sew_t<x>::type &vd = vd_group.elt<type_sew_t<x>::type>(i, true); \
   type_sew_t<x>::type rs1 = (type_sew_t<x>::type)RS1; \
-  type_sew_t<x>::type vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i);
+  type_sew_t<x>::type vs2 = vs2_group.elt<type_sew_t<x>::type>(i);
 
 #define VI_PARAMS(x) \
-  type_sew_t<x>::type &vd = P.VU.elt<type_sew_t<x>::type>(rd_num, i, true); \
+  type_sew_t<x>::type &vd = vd_group.elt<type_sew_t<x>::type>(i, true); \
   type_sew_t<x>::type simm5 = (type_sew_t<x>::type)insn.v_simm5(); \
-  type_sew_t<x>::type vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i);
+  type_sew_t<x>::type vs2 = vs2_group.elt<type_sew_t<x>::type>(i);
 
 #define XV_PARAMS(x) \
-  type_sew_t<x>::type &vd = P.VU.elt<type_sew_t<x>::type>(rd_num, i, true); \
-  type_usew_t<x>::type vs2 = P.VU.elt<type_usew_t<x>::type>(rs2_num, RS1);
+  type_sew_t<x>::type &vd = vd_group.elt<type_sew_t<x>::type>(i, true); \
+  type_usew_t<x>::type vs2 = vs2_group.elt<type_usew_t<x>::type>(RS1);
 
 #define VV_UCMP_PARAMS(x) \
-  type_usew_t<x>::type vs1 = P.VU.elt<type_usew_t<x>::type>(rs1_num, i); \
-  type_usew_t<x>::type vs2 = P.VU.elt<type_usew_t<x>::type>(rs2_num, i);
+  type_usew_t<x>::type vs1 = vs1_group.elt<type_usew_t<x>::type>(i); \
+  type_usew_t<x>::type vs2 = vs2_group.elt<type_usew_t<x>::type>(i);
 
 #define VX_UCMP_PARAMS(x) \
   type_usew_t<x>::type rs1 = (type_usew_t<x>::type)RS1; \
-  type_usew_t<x>::type vs2 = P.VU.elt<type_usew_t<x>::type>(rs2_num, i);
+  type_usew_t<x>::type vs2 = vs2_group.elt<type_usew_t<x>::type>(i);
 
 #define VI_UCMP_PARAMS(x) \
-  type_usew_t<x>::type vs2 = P.VU.elt<type_usew_t<x>::type>(rs2_num, i);
+  type_usew_t<x>::type vs2 = vs2_group.elt<type_usew_t<x>::type>(i);
 
 #define VV_CMP_PARAMS(x) \
-  type_sew_t<x>::type vs1 = P.VU.elt<type_sew_t<x>::type>(rs1_num, i); \
-  type_sew_t<x>::type vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i);
+  type_sew_t<x>::type vs1 = vs1_group.elt<type_sew_t<x>::type>(i); \
+  type_sew_t<x>::type vs2 = vs2_group.elt<type_sew_t<x>::type>(i);
 
 #define VX_CMP_PARAMS(x) \
   type_sew_t<x>::type rs1 = (type_sew_t<x>::type)RS1; \
-  type_sew_t<x>::type vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i);
+  type_sew_t<x>::type vs2 = vs2_group.elt<type_sew_t<x>::type>(i);
 
 #define VI_CMP_PARAMS(x) \
   type_sew_t<x>::type simm5 = (type_sew_t<x>::type)insn.v_simm5(); \
-  type_sew_t<x>::type vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i);
+  type_sew_t<x>::type vs2 = vs2_group.elt<type_sew_t<x>::type>(i);
 
 #define VI_XI_SLIDEDOWN_PARAMS(x, off) \
-  auto &vd = P.VU.elt<type_sew_t<x>::type>(rd_num, i, true); \
-  auto vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i + off);
+  auto &vd = vd_group.elt<type_sew_t<x>::type>(i, true); \
+  auto vs2 = vs2_group.elt<type_sew_t<x>::type>(i + off);
 
 #define VI_XI_SLIDEUP_PARAMS(x, offset) \
-  auto &vd = P.VU.elt<type_sew_t<x>::type>(rd_num, i, true); \
-  auto vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i - offset);
+  auto &vd = vd_group.elt<type_sew_t<x>::type>(i, true); \
+  auto vs2 = vs2_group.elt<type_sew_t<x>::type>(i - offset);
 
 #define VI_NSHIFT_PARAMS(sew1, sew2) \
-  auto &vd = P.VU.elt<type_usew_t<sew1>::type>(rd_num, i, true); \
-  auto vs2_u = P.VU.elt<type_usew_t<sew2>::type>(rs2_num, i); \
-  auto vs2 = P.VU.elt<type_sew_t<sew2>::type>(rs2_num, i); \
+  auto &vd = vd_group.elt<type_usew_t<sew1>::type>(i, true); \
+  auto vs2_u = vs2_group.elt<type_usew_t<sew2>::type>(i); \
+  auto vs2 = vs2_group.elt<type_sew_t<sew2>::type>(i); \
   auto zimm5 = (type_usew_t<sew1>::type)insn.v_zimm5();
 
 #define VX_NSHIFT_PARAMS(sew1, sew2) \
-  auto &vd = P.VU.elt<type_usew_t<sew1>::type>(rd_num, i, true); \
-  auto vs2_u = P.VU.elt<type_usew_t<sew2>::type>(rs2_num, i); \
-  auto vs2 = P.VU.elt<type_sew_t<sew2>::type>(rs2_num, i); \
+  auto &vd = vd_group.elt<type_usew_t<sew1>::type>(i, true); \
+  auto vs2_u = vs2_group.elt<type_usew_t<sew2>::type>(i); \
+  auto vs2 = vs2_group.elt<type_sew_t<sew2>::type>(i); \
   auto rs1 = (type_sew_t<sew1>::type)RS1;
 
 #define VV_NSHIFT_PARAMS(sew1, sew2) \
-  auto &vd = P.VU.elt<type_usew_t<sew1>::type>(rd_num, i, true); \
-  auto vs2_u = P.VU.elt<type_usew_t<sew2>::type>(rs2_num, i); \
-  auto vs2 = P.VU.elt<type_sew_t<sew2>::type>(rs2_num, i); \
-  auto vs1 = P.VU.elt<type_sew_t<sew1>::type>(rs1_num, i);
+  auto &vd = vd_group.elt<type_usew_t<sew1>::type>(i, true); \
+  auto vs2_u = vs2_group.elt<type_usew_t<sew2>::type>(i); \
+  auto vs2 = vs2_group.elt<type_sew_t<sew2>::type>(i); \
+  auto vs1 = vs1_group.elt<type_sew_t<sew1>::type>(i);
 
 #define XI_CARRY_PARAMS(x) \
-  auto vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i); \
+  auto vs2 = vs2_group.elt<type_sew_t<x>::type>(i); \
   auto rs1 = (type_sew_t<x>::type)RS1; \
   auto simm5 = (type_sew_t<x>::type)insn.v_simm5(); \
-  auto &vd = P.VU.elt<uint64_t>(rd_num, midx, true);
+  auto &vd = vd_group.elt<uint64_t>(midx, true);
 
 #define VV_CARRY_PARAMS(x) \
-  auto vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i); \
-  auto vs1 = P.VU.elt<type_sew_t<x>::type>(rs1_num, i); \
-  auto &vd = P.VU.elt<uint64_t>(rd_num, midx, true);
+  auto vs2 = vs2_group.elt<type_sew_t<x>::type>(i); \
+  auto vs1 = vs1_group.elt<type_sew_t<x>::type>(i); \
+  auto &vd = vd_group.elt<uint64_t>(midx, true);
 
 #define XI_WITH_CARRY_PARAMS(x) \
-  auto vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i); \
+  auto vs2 = vs2_group.elt<type_sew_t<x>::type>(i); \
   auto rs1 = (type_sew_t<x>::type)RS1; \
   auto simm5 = (type_sew_t<x>::type)insn.v_simm5(); \
-  auto &vd = P.VU.elt<type_sew_t<x>::type>(rd_num, i, true);
+  auto &vd = vd_group.elt<type_sew_t<x>::type>(i, true);
 
 #define VV_WITH_CARRY_PARAMS(x) \
-  auto vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i); \
-  auto vs1 = P.VU.elt<type_sew_t<x>::type>(rs1_num, i); \
-  auto &vd = P.VU.elt<type_sew_t<x>::type>(rd_num, i, true);
+  auto vs2 = vs2_group.elt<type_sew_t<x>::type>(i); \
+  auto vs1 = vs1_group.elt<type_sew_t<x>::type>(i); \
+  auto &vd = vd_group.elt<type_sew_t<x>::type>(i, true);
 
 //
 // vector: integer and masking operation loop
@@ -997,11 +1102,12 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
   reg_t rd_num = insn.rd(); \
   reg_t rs1_num = insn.rs1(); \
   reg_t rs2_num = insn.rs2(); \
-  auto &vd_0_des = P.VU.elt<type_sew_t<x>::type>(rd_num, 0, true); \
-  auto vd_0_res = P.VU.elt<type_sew_t<x>::type>(rs1_num, 0); \
+  VI_GROUP_VIEWS; \
+  auto &vd_0_des = vd_group.elt<type_sew_t<x>::type>(0, true); \
+  auto vd_0_res = vs1_group.elt<type_sew_t<x>::type>(0); \
   for (reg_t i=P.VU.vstart; i<vl; ++i){ \
     VI_LOOP_ELEMENT_SKIP(); \
-    auto vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i); \
+    auto vs2 = vs2_group.elt<type_sew_t<x>::type>(i); \
 
 #define REDUCTION_LOOP(x, BODY) \
   VI_LOOP_REDUCTION_BASE(x) \
@@ -1028,11 +1134,12 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
   reg_t rd_num = insn.rd(); \
   reg_t rs1_num = insn.rs1(); \
   reg_t rs2_num = insn.rs2(); \
-  auto &vd_0_des = P.VU.elt<type_usew_t<x>::type>(rd_num, 0, true); \
-  auto vd_0_res = P.VU.elt<type_usew_t<x>::type>(rs1_num, 0); \
+  VI_GROUP_VIEWS; \
+  auto &vd_0_des = vd_group.elt<type_usew_t<x>::type>(0, true); \
+  auto vd_0_res = vs1_group.elt<type_usew_t<x>::type>(0); \
   for (reg_t i=P.VU.vstart; i<vl; ++i){ \
     VI_LOOP_ELEMENT_SKIP(); \
-    auto vs2 = P.VU.elt<type_usew_t<x>::type>(rs2_num, i);
+    auto vs2 = vs2_group.elt<type_usew_t<x>::type>(i);
 
 #define REDUCTION_ULOOP(x, BODY) \
   VI_ULOOP_REDUCTION_BASE(x) \
@@ -1074,6 +1181,9 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
 
 #define VI_VV_LOOP(BODY) \
   VI_CHECK_SSS(true) \
+  if (VI_CAN_LOOP_CONTIGUOUS) { \
+    VI_CONTIGUOUS_LOOP(VV, BODY) \
+  } else { \
   VI_LOOP_BASE \
   if (sew == e8){ \
     VV_PARAMS(e8); \
@@ -1088,7 +1198,8 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
     VV_PARAMS(e64); \
     BODY; \
   } \
-  VI_LOOP_END 
+  VI_LOOP_END \
+  }
 
 #define VI_VX_ULOOP(BODY) \
   VI_CHECK_SSS(false) \
@@ -1110,6 +1221,9 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
 
 #define VI_VX_LOOP(BODY) \
   VI_CHECK_SSS(false) \
+  if (VI_CAN_LOOP_CONTIGUOUS) { \
+    VI_CONTIGUOUS_LOOP(VX, BODY) \
+  } else { \
   VI_LOOP_BASE \
   if (sew == e8){ \
     VX_PARAMS(e8); \
@@ -1124,7 +1238,8 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
     VX_PARAMS(e64); \
     BODY; \
   } \
-  VI_LOOP_END 
+  VI_LOOP_END \
+  }
 
 #define VI_VI_ULOOP(BODY) \
   VI_CHECK_SSS(false) \
@@ -1146,6 +1261,9 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
 
 #define VI_VI_LOOP(BODY) \
   VI_CHECK_SSS(false) \
+  if (VI_CAN_LOOP_CONTIGUOUS) { \
+    VI_CONTIGUOUS_LOOP(VI, BODY) \
+  } else { \
   VI_LOOP_BASE \
   if (sew == e8){ \
     VI_PARAMS(e8); \
@@ -1160,7 +1278,8 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
     VI_PARAMS(e64); \
     BODY; \
   } \
-  VI_LOOP_END 
+  VI_LOOP_END \
+  }
 
 // narrow operation loop
 #define VI_VV_LOOP_NARROW(BODY) \
@@ -1179,11 +1298,11 @@ if (sew == e8){ \
 VI_LOOP_END 
 
 #define VI_NARROW_SHIFT(sew1, sew2) \
-  type_usew_t<sew1>::type &vd = P.VU.elt<type_usew_t<sew1>::type>(rd_num, i, true); \
-  type_usew_t<sew2>::type vs2_u = P.VU.elt<type_usew_t<sew2>::type>(rs2_num, i); \
+  type_usew_t<sew1>::type &vd = vd_group.elt<type_usew_t<sew1>::type>(i, true); \
+  type_usew_t<sew2>::type vs2_u = vs2_group.elt<type_usew_t<sew2>::type>(i); \
   type_usew_t<sew1>::type zimm5 = (type_usew_t<sew1>::type)insn.v_zimm5(); \
-  type_sew_t<sew2>::type vs2 = P.VU.elt<type_sew_t<sew2>::type>(rs2_num, i); \
-  type_sew_t<sew1>::type vs1 = P.VU.elt<type_sew_t<sew1>::type>(rs1_num, i); \
+  type_sew_t<sew2>::type vs2 = vs2_group.elt<type_sew_t<sew2>::type>(i); \
+  type_sew_t<sew1>::type vs1 = vs1_group.elt<type_sew_t<sew1>::type>(i); \
   type_sew_t<sew1>::type rs1 = (type_sew_t<sew1>::type)RS1; 
 
 #define VI_VVXI_LOOP_NARROW(BODY, is_vs1) \
@@ -1278,20 +1397,20 @@ VI_LOOP_END
 #define VI_WIDE_OP_AND_ASSIGN(var0, var1, var2, op0, op1, sign) \
   switch(P.VU.vsew) { \
   case e8: { \
-    sign##16_t vd_w = P.VU.elt<sign##16_t>(rd_num, i); \
-    P.VU.elt<uint16_t>(rd_num, i, true) = \
+    sign##16_t vd_w = vd_group.elt<sign##16_t>(i); \
+    vd_group.elt<uint16_t>(i, true) = \
       op1((sign##16_t)(sign##8_t)var0 op0 (sign##16_t)(sign##8_t)var1) + var2; \
     } \
     break; \
   case e16: { \
-    sign##32_t vd_w = P.VU.elt<sign##32_t>(rd_num, i); \
-    P.VU.elt<uint32_t>(rd_num, i, true) = \
+    sign##32_t vd_w = vd_group.elt<sign##32_t>(i); \
+    vd_group.elt<uint32_t>(i, true) = \
       op1((sign##32_t)(sign##16_t)var0 op0 (sign##32_t)(sign##16_t)var1) + var2; \
     } \
     break; \
   default: { \
-    sign##64_t vd_w = P.VU.elt<sign##64_t>(rd_num, i); \
-    P.VU.elt<uint64_t>(rd_num, i, true) = \
+    sign##64_t vd_w = vd_group.elt<sign##64_t>(i); \
+    vd_group.elt<uint64_t>(i, true) = \
       op1((sign##64_t)(sign##32_t)var0 op0 (sign##64_t)(sign##32_t)var1) + var2; \
     } \
     break; \
@@ -1300,20 +1419,20 @@ VI_LOOP_END
 #define VI_WIDE_OP_AND_ASSIGN_MIX(var0, var1, var2, op0, op1, sign_d, sign_1, sign_2) \
   switch(P.VU.vsew) { \
   case e8: { \
-    sign_d##16_t vd_w = P.VU.elt<sign_d##16_t>(rd_num, i); \
-    P.VU.elt<uint16_t>(rd_num, i, true) = \
+    sign_d##16_t vd_w = vd_group.elt<sign_d##16_t>(i); \
+    vd_group.elt<uint16_t>(i, true) = \
       op1((sign_1##16_t)(sign_1##8_t)var0 op0 (sign_2##16_t)(sign_2##8_t)var1) + var2; \
     } \
     break; \
   case e16: { \
-    sign_d##32_t vd_w = P.VU.elt<sign_d##32_t>(rd_num, i); \
-    P.VU.elt<uint32_t>(rd_num, i, true) = \
+    sign_d##32_t vd_w = vd_group.elt<sign_d##32_t>(i); \
+    vd_group.elt<uint32_t>(i, true) = \
       op1((sign_1##32_t)(sign_1##16_t)var0 op0 (sign_2##32_t)(sign_2##16_t)var1) + var2; \
     } \
     break; \
   default: { \
-    sign_d##64_t vd_w = P.VU.elt<sign_d##64_t>(rd_num, i); \
-    P.VU.elt<uint64_t>(rd_num, i, true) = \
+    sign_d##64_t vd_w = vd_group.elt<sign_d##64_t>(i); \
+    vd_group.elt<uint64_t>(i, true) = \
       op1((sign_1##64_t)(sign_1##32_t)var0 op0 (sign_2##64_t)(sign_2##32_t)var1) + var2; \
     } \
     break; \
@@ -1322,20 +1441,20 @@ VI_LOOP_END
 #define VI_WIDE_WVX_OP(var0, op0, sign) \
   switch(P.VU.vsew) { \
   case e8: { \
-    sign##16_t &vd_w = P.VU.elt<sign##16_t>(rd_num, i, true); \
-    sign##16_t vs2_w = P.VU.elt<sign##16_t>(rs2_num, i); \
+    sign##16_t &vd_w = vd_group.elt<sign##16_t>(i, true); \
+    sign##16_t vs2_w = vs2_group.elt<sign##16_t>(i); \
     vd_w = vs2_w op0 (sign##16_t)(sign##8_t)var0; \
     } \
     break; \
   case e16: { \
-    sign##32_t &vd_w = P.VU.elt<sign##32_t>(rd_num, i, true); \
-    sign##32_t vs2_w = P.VU.elt<sign##32_t>(rs2_num, i); \
+    sign##32_t &vd_w = vd_group.elt<sign##32_t>(i, true); \
+    sign##32_t vs2_w = vs2_group.elt<sign##32_t>(i); \
     vd_w = vs2_w op0 (sign##32_t)(sign##16_t)var0; \
     } \
     break; \
   default: { \
-    sign##64_t &vd_w = P.VU.elt<sign##64_t>(rd_num, i, true); \
-    sign##64_t vs2_w = P.VU.elt<sign##64_t>(rs2_num, i); \
+    sign##64_t &vd_w = vd_group.elt<sign##64_t>(i, true); \
+    sign##64_t vs2_w = vs2_group.elt<sign##64_t>(i); \
     vd_w = vs2_w op0 (sign##64_t)(sign##32_t)var0; \
     } \
     break; \
@@ -1347,11 +1466,12 @@ VI_LOOP_END
   reg_t rd_num = insn.rd(); \
   reg_t rs1_num = insn.rs1(); \
   reg_t rs2_num = insn.rs2(); \
-  auto &vd_0_des = P.VU.elt<type_sew_t<sew2>::type>(rd_num, 0, true); \
-  auto vd_0_res = P.VU.elt<type_sew_t<sew2>::type>(rs1_num, 0); \
+  VI_GROUP_VIEWS; \
+  auto &vd_0_des = vd_group.elt<type_sew_t<sew2>::type>(0, true); \
+  auto vd_0_res = vs1_group.elt<type_sew_t<sew2>::type>(0); \
   for (reg_t i=P.VU.vstart; i<vl; ++i){ \
     VI_LOOP_ELEMENT_SKIP(); \
-    auto vs2 = P.VU.elt<type_sew_t<sew1>::type>(rs2_num, i);
+    auto vs2 = vs2_group.elt<type_sew_t<sew1>::type>(i);
 
 #define WIDE_REDUCTION_LOOP(sew1, sew2, BODY) \
   VI_LOOP_WIDE_REDUCTION_BASE(sew1, sew2) \
@@ -1375,11 +1495,12 @@ VI_LOOP_END
   reg_t rd_num = insn.rd(); \
   reg_t rs1_num = insn.rs1(); \
   reg_t rs2_num = insn.rs2(); \
-  auto &vd_0_des = P.VU.elt<type_usew_t<sew2>::type>(rd_num, 0, true); \
-  auto vd_0_res = P.VU.elt<type_usew_t<sew2>::type>(rs1_num, 0); \
+  VI_GROUP_VIEWS; \
+  auto &vd_0_des = vd_group.elt<type_usew_t<sew2>::type>(0, true); \
+  auto vd_0_res = vs1_group.elt<type_usew_t<sew2>::type>(0); \
   for (reg_t i=P.VU.vstart; i<vl; ++i) { \
     VI_LOOP_ELEMENT_SKIP(); \
-    auto vs2 = P.VU.elt<type_usew_t<sew1>::type>(rs2_num, i);
+    auto vs2 = vs2_group.elt<type_usew_t<sew1>::type>(i);
 
 #define WIDE_REDUCTION_ULOOP(sew1, sew2, BODY) \
   VI_ULOOP_WIDE_REDUCTION_BASE(sew1, sew2) \
@@ -1600,6 +1721,63 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
   } \
   P.VU.vstart = 0;
 
+//
+// Unmasked unit-stride and whole-register accesses copy each run of elements
+// that lies within one page straight between memory and the register group
+// when the page hits in the TLB.  Anything else (misaligned elements, TLB
+// misses, MMIO, faults) is done one element at a time with vstart set to that
+// element, so a fault leaves vstart exactly where the element loop would.
+#if defined(WORDS_BIGENDIAN) || defined(RISCV_ENABLE_COMMITLOG)
+#define VI_CAN_LDST_DIRECT false
+#else
+#define VI_CAN_LDST_DIRECT true
+#endif
+
+#define VI_LDST_DIRECT_RUN(elt_width) \
+    const reg_t addr = baseAddr + i * sizeof(elt_width##_t); \
+    const reg_t run = std::min<reg_t>(end_ - i, \
+      (PGSIZE - addr % PGSIZE) / sizeof(elt_width##_t)); \
+    const reg_t bytes = run * sizeof(elt_width##_t); \
+    const bool aligned = addr % sizeof(elt_width##_t) == 0;
+
+#define VI_LD_DIRECT(vreg, start, end, elt_width) \
+  for (reg_t i = (start), end_ = (end); i < end_; ) { \
+    VI_LDST_DIRECT_RUN(elt_width); \
+    if (char* host = aligned ? MMU.direct_load_addr(addr, bytes) : NULL) { \
+      memcpy(P.VU.elt_group<elt_width##_t>(vreg, i, i + run, true) + i, host, bytes); \
+      i += run; \
+    } else { \
+      P.VU.vstart = i; \
+      P.VU.elt<elt_width##_t>(vreg, i, true) = MMU.load_##elt_width(addr); \
+      ++i; \
+    } \
+  }
+
+#define VI_ST_DIRECT(vreg, start, end, elt_width) \
+  for (reg_t i = (start), end_ = (end); i < end_; ) { \
+    VI_LDST_DIRECT_RUN(elt_width); \
+    if (char* host = aligned ? MMU.direct_store_addr(addr, bytes) : NULL) { \
+      memcpy(host, P.VU.elt_group<elt_width##_t>(vreg, i, i + run) + i, bytes); \
+      i += run; \
+    } else { \
+      P.VU.vstart = i; \
+      MMU.store_##elt_width(addr, P.VU.elt<elt_width##_t>(vreg, i)); \
+      ++i; \
+    } \
+  }
+
+#define VI_LD_UNIT_STRIDE(elt_width, is_mask_ldst) \
+  if (VI_CAN_LDST_DIRECT && insn.v_nf() == 0 && insn.v_vm() == 1) { \
+    const reg_t nf = 1; \
+    const reg_t vl = is_mask_ldst ? ((P.VU.vl + 7) / 8) : P.VU.vl; \
+    const reg_t baseAddr = RS1; \
+    VI_CHECK_LOAD(elt_width, is_mask_ldst); \
+    VI_LD_DIRECT(insn.rd(), P.VU.vstart, vl, elt_width); \
+    P.VU.vstart = 0; \
+  } else { \
+    VI_LD(0, (i * nf + fn), elt_width, is_mask_ldst); \
+  }
+
 #define VI_LD_INDEX(elt_width, is_seg) \
   const reg_t nf = insn.v_nf() + 1; \
   const reg_t vl = P.VU.vl; \
@@ -1654,6 +1832,18 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
   } \
   P.VU.vstart = 0;
 
+#define VI_ST_UNIT_STRIDE(elt_width, is_mask_ldst) \
+  if (VI_CAN_LDST_DIRECT && insn.v_nf() == 0 && insn.v_vm() == 1) { \
+    const reg_t nf = 1; \
+    const reg_t vl = is_mask_ldst ? ((P.VU.vl + 7) / 8) : P.VU.vl; \
+    const reg_t baseAddr = RS1; \
+    VI_CHECK_STORE(elt_width, is_mask_ldst); \
+    VI_ST_DIRECT(insn.rd(), P.VU.vstart, vl, elt_width); \
+    P.VU.vstart = 0; \
+  } else { \
+    VI_ST(0, (i * nf + fn), elt_width, is_mask_ldst); \
+  }
+
 #define VI_ST_INDEX(elt_width, is_seg) \
   const reg_t nf = insn.v_nf() + 1; \
   const reg_t vl = P.VU.vl; \
@@ -1732,7 +1922,9 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
   require_align(vd, len); \
   const reg_t elt_per_reg = P.VU.vlenb / sizeof(elt_width ## _t); \
   const reg_t size = len * elt_per_reg; \
-  if (P.VU.vstart < size) { \
+  if (VI_CAN_LDST_DIRECT) { \
+    VI_LD_DIRECT(vd, P.VU.vstart, size, elt_width); \
+  } else if (P.VU.vstart < size) { \
     reg_t i = P.VU.vstart / elt_per_reg; \
     reg_t off = P.VU.vstart % elt_per_reg; \
     if (off) { \
@@ -1763,7 +1955,9 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
   require_align(vs3, len); \
   const reg_t size = len * P.VU.vlenb; \
    \
-  if (P.VU.vstart < size) { \
+  if (VI_CAN_LDST_DIRECT) { \
+    VI_ST_DIRECT(vs3, P.VU.vstart, size, uint8); \
+  } else if (P.VU.vstart < size) { \
     reg_t i = P.VU.vstart / P.VU.vlenb; \
     reg_t off = P.VU.vstart % P.VU.vlenb; \
     if (off) { \
@@ -1857,25 +2051,25 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
   VI_LOOP_ELEMENT_SKIP(); \
     switch (pat) { \
       case 0x21: \
-        P.VU.elt<type##16_t>(rd_num, i, true) = P.VU.elt<type##8_t>(rs2_num, i); \
+        vd_group.elt<type##16_t>(i, true) = vs2_group.elt<type##8_t>(i); \
         break; \
       case 0x41: \
-        P.VU.elt<type##32_t>(rd_num, i, true) = P.VU.elt<type##8_t>(rs2_num, i); \
+        vd_group.elt<type##32_t>(i, true) = vs2_group.elt<type##8_t>(i); \
         break; \
       case 0x81: \
-        P.VU.elt<type##64_t>(rd_num, i, true) = P.VU.elt<type##8_t>(rs2_num, i); \
+        vd_group.elt<type##64_t>(i, true) = vs2_group.elt<type##8_t>(i); \
         break; \
       case 0x42: \
-        P.VU.elt<type##32_t>(rd_num, i, true) = P.VU.elt<type##16_t>(rs2_num, i); \
+        vd_group.elt<type##32_t>(i, true) = vs2_group.elt<type##16_t>(i); \
         break; \
       case 0x82: \
-        P.VU.elt<type##64_t>(rd_num, i, true) = P.VU.elt<type##16_t>(rs2_num, i); \
+        vd_group.elt<type##64_t>(i, true) = vs2_group.elt<type##16_t>(i); \
         break; \
       case 0x84: \
-        P.VU.elt<type##64_t>(rd_num, i, true) = P.VU.elt<type##32_t>(rs2_num, i); \
+        vd_group.elt<type##64_t>(i, true) = vs2_group.elt<type##32_t>(i); \
         break; \
       case 0x88: \
-        P.VU.elt<type##64_t>(rd_num, i, true) = P.VU.elt<type##32_t>(rs2_num, i); \
+        vd_group.elt<type##64_t>(i, true) = vs2_group.elt<type##32_t>(i); \
         break; \
       default: \
         break; \
@@ -1896,10 +2090,14 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
   reg_t rd_num = insn.rd(); \
   reg_t rs1_num = insn.rs1(); \
   reg_t rs2_num = insn.rs2(); \
+  VI_GROUP_VIEWS; \
   softfloat_roundingMode = STATE.frm;
 
 #define VI_VFP_LOOP_BASE \
   VI_VFP_COMMON \
+  VI_VFP_ELEMENT_LOOP_BASE
+
+#define VI_VFP_ELEMENT_LOOP_BASE \
   for (reg_t i=P.VU.vstart; i<vl; ++i){ \
     VI_LOOP_ELEMENT_SKIP();
 
@@ -1908,22 +2106,22 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
   for (reg_t i = P.VU.vstart; i < vl; ++i) { \
     VI_LOOP_ELEMENT_SKIP(); \
     uint64_t mmask = UINT64_C(1) << mpos; \
-    uint64_t &vdi = P.VU.elt<uint64_t>(rd_num, midx, true); \
+    uint64_t &vdi = vd_group.elt<uint64_t>(midx, true); \
     uint64_t res = 0;
 
 #define VI_VFP_LOOP_REDUCTION_BASE(width) \
-  float##width##_t vd_0 = P.VU.elt<float##width##_t>(rd_num, 0); \
-  float##width##_t vs1_0 = P.VU.elt<float##width##_t>(rs1_num, 0); \
+  float##width##_t vd_0 = vd_group.elt<float##width##_t>(0); \
+  float##width##_t vs1_0 = vs1_group.elt<float##width##_t>(0); \
   vd_0 = vs1_0; \
   bool is_active = false; \
   for (reg_t i=P.VU.vstart; i<vl; ++i){ \
     VI_LOOP_ELEMENT_SKIP(); \
-    float##width##_t vs2 = P.VU.elt<float##width##_t>(rs2_num, i); \
+    float##width##_t vs2 = vs2_group.elt<float##width##_t>(i); \
     is_active = true; \
 
 #define VI_VFP_LOOP_WIDE_REDUCTION_BASE \
   VI_VFP_COMMON \
-  float64_t vd_0 = f64(P.VU.elt<float64_t>(rs1_num, 0).v); \
+  float64_t vd_0 = f64(vs1_group.elt<float64_t>(0).v); \
   for (reg_t i=P.VU.vstart; i<vl; ++i) { \
     VI_LOOP_ELEMENT_SKIP();
 
@@ -1944,9 +2142,9 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
                 softfloat_exceptionFlags |= softfloat_flag_invalid; \
                 set_fp_exceptions; \
               } \
-              P.VU.elt<uint16_t>(rd_num, 0, true) = defaultNaNF16UI; \
+              vd_group.elt<uint16_t>(0, true) = defaultNaNF16UI; \
             } else { \
-              P.VU.elt<uint16_t>(rd_num, 0, true) = vd_0.v; \
+              vd_group.elt<uint16_t>(0, true) = vd_0.v; \
             } \
           } \
           break; \
@@ -1957,9 +2155,9 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
                 softfloat_exceptionFlags |= softfloat_flag_invalid; \
                 set_fp_exceptions; \
               } \
-              P.VU.elt<uint32_t>(rd_num, 0, true) = defaultNaNF32UI; \
+              vd_group.elt<uint32_t>(0, true) = defaultNaNF32UI; \
             } else { \
-              P.VU.elt<uint32_t>(rd_num, 0, true) = vd_0.v; \
+              vd_group.elt<uint32_t>(0, true) = vd_0.v; \
             } \
           } \
           break; \
@@ -1970,15 +2168,15 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
                 softfloat_exceptionFlags |= softfloat_flag_invalid; \
                 set_fp_exceptions; \
               } \
-              P.VU.elt<uint64_t>(rd_num, 0, true) = defaultNaNF64UI; \
+              vd_group.elt<uint64_t>(0, true) = defaultNaNF64UI; \
             } else { \
-              P.VU.elt<uint64_t>(rd_num, 0, true) = vd_0.v; \
+              vd_group.elt<uint64_t>(0, true) = vd_0.v; \
             } \
           } \
           break; \
       } \
     } else { \
-      P.VU.elt<type_sew_t<x>::type>(rd_num, 0, true) = vd_0.v; \
+      vd_group.elt<type_sew_t<x>::type>(0, true) = vd_0.v; \
     } \
   }
 
@@ -1999,28 +2197,32 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
 
 #define VI_VFP_VV_LOOP(BODY16, BODY32, BODY64) \
   VI_CHECK_SSS(true); \
-  VI_VFP_LOOP_BASE \
+  VI_VFP_COMMON \
+  VI_VFP_VV_ELEMENT_LOOP(BODY16, BODY32, BODY64)
+
+#define VI_VFP_VV_ELEMENT_LOOP(BODY16, BODY32, BODY64) \
+  VI_VFP_ELEMENT_LOOP_BASE \
   switch(P.VU.vsew) { \
     case e16: {\
-      float16_t &vd = P.VU.elt<float16_t>(rd_num, i, true); \
-      float16_t vs1 = P.VU.elt<float16_t>(rs1_num, i); \
-      float16_t vs2 = P.VU.elt<float16_t>(rs2_num, i); \
+      float16_t &vd = vd_group.elt<float16_t>(i, true); \
+      float16_t vs1 = vs1_group.elt<float16_t>(i); \
+      float16_t vs2 = vs2_group.elt<float16_t>(i); \
       BODY16; \
       set_fp_exceptions; \
       break; \
     }\
     case e32: {\
-      float32_t &vd = P.VU.elt<float32_t>(rd_num, i, true); \
-      float32_t vs1 = P.VU.elt<float32_t>(rs1_num, i); \
-      float32_t vs2 = P.VU.elt<float32_t>(rs2_num, i); \
+      float32_t &vd = vd_group.elt<float32_t>(i, true); \
+      float32_t vs1 = vs1_group.elt<float32_t>(i); \
+      float32_t vs2 = vs2_group.elt<float32_t>(i); \
       BODY32; \
       set_fp_exceptions; \
       break; \
     }\
     case e64: {\
-      float64_t &vd = P.VU.elt<float64_t>(rd_num, i, true); \
-      float64_t vs1 = P.VU.elt<float64_t>(rs1_num, i); \
-      float64_t vs2 = P.VU.elt<float64_t>(rs2_num, i); \
+      float64_t &vd = vd_group.elt<float64_t>(i, true); \
+      float64_t vs1 = vs1_group.elt<float64_t>(i); \
+      float64_t vs2 = vs2_group.elt<float64_t>(i); \
       BODY64; \
       set_fp_exceptions; \
       break; \
@@ -2037,20 +2239,20 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
   VI_VFP_LOOP_BASE \
   switch(P.VU.vsew) { \
     case e16: {\
-      float16_t &vd = P.VU.elt<float16_t>(rd_num, i, true); \
-      float16_t vs2 = P.VU.elt<float16_t>(rs2_num, i); \
+      float16_t &vd = vd_group.elt<float16_t>(i, true); \
+      float16_t vs2 = vs2_group.elt<float16_t>(i); \
       BODY16; \
       break; \
     }\
     case e32: {\
-      float32_t &vd = P.VU.elt<float32_t>(rd_num, i, true); \
-      float32_t vs2 = P.VU.elt<float32_t>(rs2_num, i); \
+      float32_t &vd = vd_group.elt<float32_t>(i, true); \
+      float32_t vs2 = vs2_group.elt<float32_t>(i); \
       BODY32; \
       break; \
     }\
     case e64: {\
-      float64_t &vd = P.VU.elt<float64_t>(rd_num, i, true); \
-      float64_t vs2 = P.VU.elt<float64_t>(rs2_num, i); \
+      float64_t &vd = vd_group.elt<float64_t>(i, true); \
+      float64_t vs2 = vs2_group.elt<float64_t>(i); \
       BODY64; \
       break; \
     }\
@@ -2099,22 +2301,22 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
   bool is_active = false; \
   switch(P.VU.vsew) { \
     case e16: {\
-      float32_t vd_0 = P.VU.elt<float32_t>(rs1_num, 0); \
+      float32_t vd_0 = vs1_group.elt<float32_t>(0); \
       for (reg_t i=P.VU.vstart; i<vl; ++i) { \
         VI_LOOP_ELEMENT_SKIP(); \
         is_active = true; \
-        float32_t vs2 = f16_to_f32(P.VU.elt<float16_t>(rs2_num, i)); \
+        float32_t vs2 = f16_to_f32(vs2_group.elt<float16_t>(i)); \
         BODY16; \
         set_fp_exceptions; \
       VI_VFP_LOOP_REDUCTION_END(e32) \
       break; \
     }\
     case e32: {\
-      float64_t vd_0 = P.VU.elt<float64_t>(rs1_num, 0); \
+      float64_t vd_0 = vs1_group.elt<float64_t>(0); \
       for (reg_t i=P.VU.vstart; i<vl; ++i) { \
         VI_LOOP_ELEMENT_SKIP(); \
         is_active = true; \
-        float64_t vs2 = f32_to_f64(P.VU.elt<float32_t>(rs2_num, i)); \
+        float64_t vs2 = f32_to_f64(vs2_group.elt<float32_t>(i)); \
         BODY32; \
         set_fp_exceptions; \
       VI_VFP_LOOP_REDUCTION_END(e64) \
@@ -2127,28 +2329,32 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
 
 #define VI_VFP_VF_LOOP(BODY16, BODY32, BODY64) \
   VI_CHECK_SSS(false); \
-  VI_VFP_LOOP_BASE \
+  VI_VFP_COMMON \
+  VI_VFP_VF_ELEMENT_LOOP(BODY16, BODY32, BODY64)
+
+#define VI_VFP_VF_ELEMENT_LOOP(BODY16, BODY32, BODY64) \
+  VI_VFP_ELEMENT_LOOP_BASE \
   switch(P.VU.vsew) { \
     case e16: {\
-      float16_t &vd = P.VU.elt<float16_t>(rd_num, i, true); \
+      float16_t &vd = vd_group.elt<float16_t>(i, true); \
       float16_t rs1 = f16(READ_FREG(rs1_num)); \
-      float16_t vs2 = P.VU.elt<float16_t>(rs2_num, i); \
+      float16_t vs2 = vs2_group.elt<float16_t>(i); \
       BODY16; \
       set_fp_exceptions; \
       break; \
     }\
     case e32: {\
-      float32_t &vd = P.VU.elt<float32_t>(rd_num, i, true); \
+      float32_t &vd = vd_group.elt<float32_t>(i, true); \
       float32_t rs1 = f32(READ_FREG(rs1_num)); \
-      float32_t vs2 = P.VU.elt<float32_t>(rs2_num, i); \
+      float32_t vs2 = vs2_group.elt<float32_t>(i); \
       BODY32; \
       set_fp_exceptions; \
       break; \
     }\
     case e64: {\
-      float64_t &vd = P.VU.elt<float64_t>(rd_num, i, true); \
+      float64_t &vd = vd_group.elt<float64_t>(i, true); \
       float64_t rs1 = f64(READ_FREG(rs1_num)); \
-      float64_t vs2 = P.VU.elt<float64_t>(rs2_num, i); \
+      float64_t vs2 = vs2_group.elt<float64_t>(i); \
       BODY64; \
       set_fp_exceptions; \
       break; \
@@ -2160,29 +2366,121 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
   DEBUG_RVV_FP_VF; \
   VI_VFP_LOOP_END
 
+//
+// vector: batched vfp loops
+//
+// Unmasked vfadd, vfmul and vfmacc-style loops at SEW=32 or 64 in
+// round-to-nearest-even mode compute vd = OP(A, B, C) on whole batches of
+// elements with the host kernels in host_fp.h.  A, B and C are written in
+// terms of the elements of vd, vs1 or rs1, and vs2 as host floats.  A batch
+// the host can't do exactly like softfloat is redone element by element with
+// BODY, as are the leftover elements.  The operand groups are either the
+// same or disjoint, so this gives the same result.
+#define VI_VFP_CAN_BATCH(x) \
+  (VI_CAN_LOOP_CONTIGUOUS && HOST_FP_ENABLED && P.VU.vsew == e##x && \
+   P.VU.vstart < vl)
+
+#define VV_BATCH_GROUP(x) \
+  const elt_t* vs1_elts = P.VU.elt_group<elt_t>(rs1_num, P.VU.vstart, vl);
+#define VV_BATCH_HOST_ELT(k) \
+  host_t vs1 = host_fp_value(vs1_elts[k]);
+#define VV_BATCH_ELT(k) \
+  elt_t vs1 = vs1_elts[k];
+
+#define VF_BATCH_GROUP(x) \
+  const elt_t rs1_elt = f##x(READ_FREG(rs1_num)); \
+  const host_t rs1_host = host_fp_value(rs1_elt);
+#define VF_BATCH_HOST_ELT(k) \
+  host_t rs1 = rs1_host;
+#define VF_BATCH_ELT(k) \
+  elt_t rs1 = rs1_elt;
+
+#define VI_VFP_BATCH_ELT(KIND, BODY, k) \
+  { \
+    elt_t &vd = vd_elts[k]; \
+    elt_t vs2 = vs2_elts[k]; \
+    KIND##_BATCH_ELT(k) \
+    BODY; \
+  }
+
+#define VI_VFP_BATCH_LOOP(x, KIND, OP, A, B, C, BODY) \
+  { \
+    typedef float##x##_t elt_t; \
+    typedef decltype(host_fp_value(elt_t())) host_t; \
+    elt_t* vd_elts = P.VU.elt_group<elt_t>(rd_num, P.VU.vstart, vl, true); \
+    const elt_t* vs2_elts = P.VU.elt_group<elt_t>(rs2_num, P.VU.vstart, vl); \
+    KIND##_BATCH_GROUP(x) \
+    reg_t i = P.VU.vstart; \
+    for (; i + HOST_FP_BATCH <= vl; i += HOST_FP_BATCH) { \
+      host_t a[HOST_FP_BATCH], b[HOST_FP_BATCH], c[HOST_FP_BATCH]; \
+      host_t r[HOST_FP_BATCH]; \
+      for (reg_t j = 0; j < HOST_FP_BATCH; ++j) { \
+        host_t vd = host_fp_value(vd_elts[i + j]); \
+        host_t vs2 = host_fp_value(vs2_elts[i + j]); \
+        KIND##_BATCH_HOST_ELT(i + j) \
+        a[j] = A; \
+        b[j] = B; \
+        c[j] = C; \
+      } \
+      if (host_fp_##OP##_batch(r, a, b, c)) { \
+        for (reg_t j = 0; j < HOST_FP_BATCH; ++j) \
+          vd_elts[i + j] = host_fp_result(r[j]); \
+      } else { \
+        for (reg_t j = i; j < i + HOST_FP_BATCH; ++j) \
+          VI_VFP_BATCH_ELT(KIND, BODY, j) \
+      } \
+    } \
+    for (; i < vl; ++i) \
+      VI_VFP_BATCH_ELT(KIND, BODY, i) \
+    set_fp_exceptions; \
+    P.VU.vstart = 0; \
+  }
+
+#define VI_VFP_VV_LOOP_BATCH(OP, A, B, C, BODY16, BODY32, BODY64) \
+  VI_CHECK_SSS(true); \
+  VI_VFP_COMMON \
+  if (VI_VFP_CAN_BATCH(32)) \
+    VI_VFP_BATCH_LOOP(32, VV, OP, A, B, C, BODY32) \
+  else if (VI_VFP_CAN_BATCH(64)) \
+    VI_VFP_BATCH_LOOP(64, VV, OP, A, B, C, BODY64) \
+  else { \
+    VI_VFP_VV_ELEMENT_LOOP(BODY16, BODY32, BODY64) \
+  }
+
+#define VI_VFP_VF_LOOP_BATCH(OP, A, B, C, BODY16, BODY32, BODY64) \
+  VI_CHECK_SSS(false); \
+  VI_VFP_COMMON \
+  if (VI_VFP_CAN_BATCH(32)) \
+    VI_VFP_BATCH_LOOP(32, VF, OP, A, B, C, BODY32) \
+  else if (VI_VFP_CAN_BATCH(64)) \
+    VI_VFP_BATCH_LOOP(64, VF, OP, A, B, C, BODY64) \
+  else { \
+    VI_VFP_VF_ELEMENT_LOOP(BODY16, BODY32, BODY64) \
+  }
+
 #define VI_VFP_LOOP_CMP(BODY16, BODY32, BODY64, is_vs1) \
   VI_CHECK_MSS(is_vs1); \
   VI_VFP_LOOP_CMP_BASE \
   switch(P.VU.vsew) { \
     case e16: {\
-      float16_t vs2 = P.VU.elt<float16_t>(rs2_num, i); \
-      float16_t vs1 = P.VU.elt<float16_t>(rs1_num, i); \
+      float16_t vs2 = vs2_group.elt<float16_t>(i); \
+      float16_t vs1 = vs1_group.elt<float16_t>(i); \
       float16_t rs1 = f16(READ_FREG(rs1_num)); \
       BODY16; \
       set_fp_exceptions; \
       break; \
     }\
     case e32: {\
-      float32_t vs2 = P.VU.elt<float32_t>(rs2_num, i); \
-      float32_t vs1 = P.VU.elt<float32_t>(rs1_num, i); \
+      float32_t vs2 = vs2_group.elt<float32_t>(i); \
+      float32_t vs1 = vs1_group.elt<float32_t>(i); \
       float32_t rs1 = f32(READ_FREG(rs1_num)); \
       BODY32; \
       set_fp_exceptions; \
       break; \
     }\
     case e64: {\
-      float64_t vs2 = P.VU.elt<float64_t>(rs2_num, i); \
-      float64_t vs1 = P.VU.elt<float64_t>(rs1_num, i); \
+      float64_t vs2 = vs2_group.elt<float64_t>(i); \
+      float64_t vs1 = vs1_group.elt<float64_t>(i); \
       float64_t rs1 = f64(READ_FREG(rs1_num)); \
       BODY64; \
       set_fp_exceptions; \
@@ -2199,16 +2497,16 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
   VI_VFP_LOOP_BASE \
   switch(P.VU.vsew) { \
     case e16: { \
-      float32_t &vd = P.VU.elt<float32_t>(rd_num, i, true); \
-      float32_t vs2 = f16_to_f32(P.VU.elt<float16_t>(rs2_num, i)); \
+      float32_t &vd = vd_group.elt<float32_t>(i, true); \
+      float32_t vs2 = f16_to_f32(vs2_group.elt<float16_t>(i)); \
       float32_t rs1 = f16_to_f32(f16(READ_FREG(rs1_num))); \
       BODY16; \
       set_fp_exceptions; \
       break; \
     } \
     case e32: {\
-      float64_t &vd = P.VU.elt<float64_t>(rd_num, i, true); \
-      float64_t vs2 = f32_to_f64(P.VU.elt<float32_t>(rs2_num, i)); \
+      float64_t &vd = vd_group.elt<float64_t>(i, true); \
+      float64_t vs2 = f32_to_f64(vs2_group.elt<float32_t>(i)); \
       float64_t rs1 = f32_to_f64(f32(READ_FREG(rs1_num))); \
       BODY32; \
       set_fp_exceptions; \
@@ -2227,17 +2525,17 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
   VI_VFP_LOOP_BASE \
   switch(P.VU.vsew) { \
     case e16: {\
-      float32_t &vd = P.VU.elt<float32_t>(rd_num, i, true); \
-      float32_t vs2 = f16_to_f32(P.VU.elt<float16_t>(rs2_num, i)); \
-      float32_t vs1 = f16_to_f32(P.VU.elt<float16_t>(rs1_num, i)); \
+      float32_t &vd = vd_group.elt<float32_t>(i, true); \
+      float32_t vs2 = f16_to_f32(vs2_group.elt<float16_t>(i)); \
+      float32_t vs1 = f16_to_f32(vs1_group.elt<float16_t>(i)); \
       BODY16; \
       set_fp_exceptions; \
       break; \
     }\
     case e32: {\
-      float64_t &vd = P.VU.elt<float64_t>(rd_num, i, true); \
-      float64_t vs2 = f32_to_f64(P.VU.elt<float32_t>(rs2_num, i)); \
-      float64_t vs1 = f32_to_f64(P.VU.elt<float32_t>(rs1_num, i)); \
+      float64_t &vd = vd_group.elt<float64_t>(i, true); \
+      float64_t vs2 = f32_to_f64(vs2_group.elt<float32_t>(i)); \
+      float64_t vs1 = f32_to_f64(vs1_group.elt<float32_t>(i)); \
       BODY32; \
       set_fp_exceptions; \
       break; \
@@ -2254,16 +2552,16 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
   VI_VFP_LOOP_BASE \
   switch(P.VU.vsew) { \
     case e16: {\
-      float32_t &vd = P.VU.elt<float32_t>(rd_num, i, true); \
-      float32_t vs2 = P.VU.elt<float32_t>(rs2_num, i); \
+      float32_t &vd = vd_group.elt<float32_t>(i, true); \
+      float32_t vs2 = vs2_group.elt<float32_t>(i); \
       float32_t rs1 = f16_to_f32(f16(READ_FREG(rs1_num))); \
       BODY16; \
       set_fp_exceptions; \
       break; \
     }\
     case e32: {\
-      float64_t &vd = P.VU.elt<float64_t>(rd_num, i, true); \
-      float64_t vs2 = P.VU.elt<float64_t>(rs2_num, i); \
+      float64_t &vd = vd_group.elt<float64_t>(i, true); \
+      float64_t vs2 = vs2_group.elt<float64_t>(i); \
       float64_t rs1 = f32_to_f64(f32(READ_FREG(rs1_num))); \
       BODY32; \
       set_fp_exceptions; \
@@ -2280,17 +2578,17 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
   VI_VFP_LOOP_BASE \
   switch(P.VU.vsew) { \
     case e16: {\
-      float32_t &vd = P.VU.elt<float32_t>(rd_num, i, true); \
-      float32_t vs2 = P.VU.elt<float32_t>(rs2_num, i); \
-      float32_t vs1 = f16_to_f32(P.VU.elt<float16_t>(rs1_num, i)); \
+      float32_t &vd = vd_group.elt<float32_t>(i, true); \
+      float32_t vs2 = vs2_group.elt<float32_t>(i); \
+      float32_t vs1 = f16_to_f32(vs1_group.elt<float16_t>(i)); \
       BODY16; \
       set_fp_exceptions; \
       break; \
     }\
     case e32: {\
-      float64_t &vd = P.VU.elt<float64_t>(rd_num, i, true); \
-      float64_t vs2 = P.VU.elt<float64_t>(rs2_num, i); \
-      float64_t vs1 = f32_to_f64(P.VU.elt<float32_t>(rs1_num, i)); \
+      float64_t &vd = vd_group.elt<float64_t>(i, true); \
+      float64_t vs2 = vs2_group.elt<float64_t>(i); \
+      float64_t vs1 = f32_to_f64(vs1_group.elt<float32_t>(i)); \
       BODY32; \
       set_fp_exceptions; \
       break; \
@@ -2312,6 +2610,7 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
   reg_t rd_num = insn.rd(); \
   reg_t rs1_num = insn.rs1(); \
   reg_t rs2_num = insn.rs2(); \
+  VI_GROUP_VIEWS; \
   softfloat_roundingMode = STATE.frm; \
   for (reg_t i=P.VU.vstart; i<vl; ++i){ \
     VI_LOOP_ELEMENT_SKIP();
@@ -2358,11 +2657,18 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
 // The p-extension support is contributed by
 // Programming Langauge Lab, Department of Computer Science, National Tsing-Hua University, Taiwan
 
+// Lane INDEX of R, by shifting it down and truncating to the lane type
+// rather than with get_field, whose mask isn't constant here and so costs
+// a divide per lane.
 #define P_FIELD(R, INDEX, SIZE) \
-  (type_sew_t<SIZE>::type)get_field(R, make_mask64(((INDEX) * SIZE), SIZE))
+  (type_sew_t<SIZE>::type)((R) >> ((INDEX) * (SIZE)))
 
 #define P_UFIELD(R, INDEX, SIZE) \
-  (type_usew_t<SIZE>::type)get_field(R, make_mask64(((INDEX) * SIZE), SIZE))
+  (type_usew_t<SIZE>::type)((R) >> ((INDEX) * (SIZE)))
+
+#define P_SET_FIELD(R, INDEX, SIZE, VAL) \
+  R = ((R) & ~(make_mask64(0, SIZE) << ((INDEX) * (SIZE)))) | \
+      ((reg_t(VAL) & make_mask64(0, SIZE)) << ((INDEX) * (SIZE)))
 
 #define P_B(R, INDEX) P_UFIELD(R, INDEX, 8)
 #define P_H(R, INDEX) P_UFIELD(R, INDEX, 16)
@@ -2381,7 +2687,7 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
 #define RD_PAIR READ_REG_PAIR(insn.rd())
 
 #define WRITE_PD() \
-  rd_tmp = set_field(rd_tmp, make_mask64((i * sizeof(pd) * 8), sizeof(pd) * 8), pd);
+  P_SET_FIELD(rd_tmp, i, sizeof(pd) * 8, pd);
 
 #define WRITE_RD_PAIR(value) \
   if (insn.rd() != 0) { \
@@ -2696,6 +3002,15 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
   P_MUL_CROSS_ULOOP_BODY(BIT, BODY) \
   P_PAIR_LOOP_END()
 
+// A saturating add or subtract done on every lane at once by the host_simd.h
+// kernel host_OP.
+#define P_SIMD_SAT(OP) \
+  require_extension('P'); \
+  bool sat = false; \
+  reg_t rd_tmp = host_##OP(zext_xlen(RS1), zext_xlen(RS2), sat); \
+  P_SET_OV(sat); \
+  WRITE_RD(sext_xlen(rd_tmp));
+
 #define P_REDUCTION_LOOP(BIT, BIT_INNER, USE_RD, IS_SAT, BODY) \
   P_REDUCTION_LOOP_BASE(BIT, BIT_INNER, USE_RD) \
   P_REDUCTION_PARAMS(BIT_INNER) \
@@ -2790,10 +3105,8 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
   require(BIT == e16 || BIT == e32); \
   reg_t rd_tmp = 0, rs1 = RS1, rs2 = RS2; \
   for (sreg_t i = 0; i < xlen / BIT / 2; i++) { \
-    rd_tmp = set_field(rd_tmp, make_mask64(i * 2 * BIT, BIT), \
-      P_UFIELD(RS2, i * 2 + Y, BIT)); \
-    rd_tmp = set_field(rd_tmp, make_mask64((i * 2 + 1) * BIT, BIT), \
-      P_UFIELD(RS1, i * 2 + X, BIT)); \
+    P_SET_FIELD(rd_tmp, i * 2, BIT, P_UFIELD(RS2, i * 2 + Y, BIT)); \
+    P_SET_FIELD(rd_tmp, i * 2 + 1, BIT, P_UFIELD(RS1, i * 2 + X, BIT)); \
   } \
   WRITE_RD(sext_xlen(rd_tmp));
 
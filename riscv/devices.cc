@@ -1,6 +1,11 @@
 #include "devices.h"
 #include "mmu.h"
+#include <errno.h>
 #include <stdexcept>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 void bus_t::add_device(reg_t addr, abstract_device_t* dev)
 {
@@ -92,14 +97,31 @@ bool mmio_plugin_device_t::store(reg_t addr, size_t len, const uint8_t* bytes)
 }
 
 mem_t::mem_t(reg_t size)
-  : sz(size)
+  : sz(size), data(NULL)
 {
   if (size == 0 || size % PGSIZE != 0)
     throw std::runtime_error("memory size must be a positive multiple of 4 KiB");
+
+  // Reserve the whole memory up front.  The host only commits (zeroed) pages
+  // on first touch, so even very large memories are cheap to create, and
+  // looking up a page is just an offset.  If the host can't reserve that
+  // much address space, fall back to allocating pages on demand.
+  if (size <= SIZE_MAX) {
+    void* res = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (res != MAP_FAILED) {
+      data = (char*)res;
+#ifdef MADV_HUGEPAGE
+      madvise(data, size, MADV_HUGEPAGE);
+#endif
+    }
+  }
 }
 
 mem_t::~mem_t()
 {
+  if (data)
+    munmap(data, sz);
   for (auto& entry : sparse_memory_map)
     free(entry.second);
 }
@@ -109,6 +131,14 @@ bool mem_t::load_store(reg_t addr, size_t len, uint8_t* bytes, bool store)
   if (addr + len < addr || addr + len > sz)
     return false;
 
+  if (data) {
+    if (store)
+      memcpy(data + addr, bytes, len);
+    else
+      memcpy(bytes, data + addr, len);
+    return true;
+  }
+
   while (len > 0) {
     auto n = std::min(PGSIZE - (addr % PGSIZE), reg_t(len));
 
@@ -126,7 +156,11 @@ bool mem_t::load_store(reg_t addr, size_t len, uint8_t* bytes, bool store)
 }
 
 char* mem_t::contents(reg_t addr) {
+  if (data)
+    return data + addr;
+
   reg_t ppn = addr >> PGSHIFT, pgoff = addr % PGSIZE;
+  std::lock_guard<std::mutex> lock(sparse_memory_lock);
   auto search = sparse_memory_map.find(ppn);
   if (search == sparse_memory_map.end()) {
     auto res = (char*)calloc(PGSIZE, 1);
@@ -137,3 +171,150 @@ char* mem_t::contents(reg_t addr) {
   }
   return search->second + pgoff;
 }
+
+static bool page_is_zero(const char* page)
+{
+  auto words = (const uint64_t*)page;
+  for (size_t i = 0; i < PGSIZE / sizeof(uint64_t); i++)
+    if (words[i])
+      return false;
+  return true;
+}
+
+static bool write_all(int fd, const char* buf, size_t len, off_t offset)
+{
+  while (len > 0) {
+    ssize_t n = pwrite(fd, buf, len, offset);
+    if (n <= 0) {
+      if (n == 0)
+        errno = 0; // the file ended, or the disk filled up
+      return false;
+    }
+    buf += n;
+    len -= n;
+    offset += n;
+  }
+  return true;
+}
+
+static bool read_all(int fd, char* buf, size_t len, off_t offset)
+{
+  while (len > 0) {
+    ssize_t n = pread(fd, buf, len, offset);
+    if (n <= 0) {
+      if (n == 0)
+        errno = 0; // the file ended, or the disk filled up
+      return false;
+    }
+    buf += n;
+    len -= n;
+    offset += n;
+  }
+  return true;
+}
+
+bool mem_t::load_file(reg_t addr, size_t len, int fd, off_t offset)
+{
+  if (addr + len < addr || addr + len > sz)
+    return false;
+
+  // Copy rather than map the file, so that the image can't change under the
+  // guest if the file is rebuilt or truncated while the simulation runs.
+  if (data)
+    return read_all(fd, data + addr, len, offset);
+
+  while (len > 0) {
+    auto n = std::min(PGSIZE - (addr % PGSIZE), reg_t(len));
+    if (!read_all(fd, contents(addr), n, offset))
+      return false;
+    addr += n;
+    len -= n;
+    offset += n;
+  }
+  return true;
+}
+
+bool mem_t::save(int fd, off_t offset)
+{
+  if (data) {
+    // write each run of nonzero pages with a single call
+    for (reg_t addr = 0; addr < sz; ) {
+      if (page_is_zero(data + addr)) {
+        addr += PGSIZE;
+        continue;
+      }
+      reg_t end = addr + PGSIZE;
+      while (end < sz && !page_is_zero(data + end))
+        end += PGSIZE;
+      if (!write_all(fd, data + addr, end - addr, offset + addr))
+        return false;
+      addr = end;
+    }
+    return true;
+  }
+
+  std::lock_guard<std::mutex> lock(sparse_memory_lock);
+  for (auto& entry : sparse_memory_map)
+    if (!page_is_zero(entry.second) &&
+        !write_all(fd, entry.second, PGSIZE, offset + (entry.first << PGSHIFT)))
+      return false;
+  return true;
+}
+
+bool mem_t::restore(int fd, off_t offset)
+{
+  if (data) {
+    // Read the image into the reservation rather than mapping the file, so
+    // that rewriting the file (even by saving a checkpoint to it) can't
+    // change guest memory.  Start from fresh zero pages and read only the
+    // parts of the image that aren't holes, so untouched memory stays
+    // uncommitted.
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+      return false;
+    if (st.st_size < offset + (off_t)sz) {
+      errno = 0;
+      return false;
+    }
+    if (mmap(data, sz, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) == MAP_FAILED)
+      return false;
+#ifdef MADV_HUGEPAGE
+    madvise(data, sz, MADV_HUGEPAGE);
+#endif
+    off_t end = offset + sz;
+    for (off_t pos = offset; pos < end; ) {
+      off_t start = lseek(fd, pos, SEEK_DATA);
+      if (start < 0 && errno != ENXIO)
+        start = pos; // no hole support: read everything
+      if (start < 0 || start >= end)
+        break; // only a hole remains
+      off_t stop = lseek(fd, start, SEEK_HOLE);
+      if (stop < 0 || stop > end)
+        stop = end;
+      if (!read_all(fd, data + (start - offset), stop - start, start))
+        return false;
+      pos = stop;
+    }
+    return true;
+  }
+
+  std::lock_guard<std::mutex> lock(sparse_memory_lock);
+  for (auto& entry : sparse_memory_map)
+    free(entry.second);
+  sparse_memory_map.clear();
+
+  char page[PGSIZE];
+  for (reg_t addr = 0; addr < sz; addr += PGSIZE) {
+    if (!read_all(fd, page, PGSIZE, offset + addr))
+      return false;
+    if (page_is_zero(page))
+      continue;
+    auto res = (char*)malloc(PGSIZE);
+    if (res == nullptr)
+      throw std::bad_alloc();
+    memcpy(res, page, PGSIZE);
+    sparse_memory_map[addr >> PGSHIFT] = res;
+  }
+  return true;
+}
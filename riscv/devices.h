@@ -6,8 +6,10 @@
 #include "abstract_device.h"
 #include "platform.h"
 #include <map>
+#include <mutex>
 #include <vector>
 #include <utility>
+#include <sys/types.h>
 
 class processor_t;
 
@@ -44,11 +46,25 @@ class mem_t : public abstract_device_t {
   char* contents(reg_t addr);
   reg_t size() { return sz; }
 
+  // Write the memory image to fd at the given offset, leaving all-zero pages
+  // as holes, and read such an image back in.  On failure, errno is 0 if the
+  // file was too short or the disk full.
+  bool save(int fd, off_t offset);
+  bool restore(int fd, off_t offset);
+
+  // Place len bytes of fd at offset at addr, reading them straight into
+  // memory.  Fails if the file is shorter than offset + len.
+  bool load_file(reg_t addr, size_t len, int fd, off_t offset);
+
  private:
   bool load_store(reg_t addr, size_t len, uint8_t* bytes, bool store);
 
-  std::map<reg_t, char*> sparse_memory_map;
   reg_t sz;
+  char* data; // flat host mapping of the whole memory, if it could be reserved
+
+  // otherwise, pages are allocated on first touch
+  std::map<reg_t, char*> sparse_memory_map;
+  std::mutex sparse_memory_lock; // harts may allocate pages concurrently
 };
 
 class clint_t : public abstract_device_t {
@@ -58,6 +74,8 @@ class clint_t : public abstract_device_t {
   bool store(reg_t addr, size_t len, const uint8_t* bytes);
   size_t size() { return CLINT_SIZE; }
   void increment(reg_t inc);
+  void save_state(std::vector<reg_t>& out);
+  void restore_state(const reg_t*& pos, const reg_t* end);
  private:
   typedef uint64_t mtime_t;
   typedef uint64_t mtimecmp_t;
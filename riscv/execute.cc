@@ -3,6 +3,7 @@
 #include "processor.h"
 #include "mmu.h"
 #include "disasm.h"
+#include "commit_trace.h"
 #include <cassert>
 
 #ifdef RISCV_ENABLE_COMMITLOG
@@ -11,6 +12,7 @@ static void commit_log_reset(processor_t* p)
   p->get_state()->log_reg_write.clear();
   p->get_state()->log_mem_read.clear();
   p->get_state()->log_mem_write.clear();
+  p->VU.written_regs = 0;
 }
 
 static void commit_log_stash_privilege(processor_t* p)
@@ -21,39 +23,6 @@ static void commit_log_stash_privilege(processor_t* p)
   state->last_inst_flen = p->get_flen();
 }
 
-static void commit_log_print_value(FILE *log_file, int width, const void *data)
-{
-  assert(log_file);
-
-  switch (width) {
-    case 8:
-      fprintf(log_file, "0x%01" PRIx8, *(const uint8_t *)data);
-      break;
-    case 16:
-      fprintf(log_file, "0x%04" PRIx16, *(const uint16_t *)data);
-      break;
-    case 32:
-      fprintf(log_file, "0x%08" PRIx32, *(const uint32_t *)data);
-      break;
-    case 64:
-      fprintf(log_file, "0x%016" PRIx64, *(const uint64_t *)data);
-      break;
-    default:
-      // max lengh of vector
-      if (((width - 1) & width) == 0) {
-        const uint64_t *arr = (const uint64_t *)data;
-
-        fprintf(log_file, "0x");
-        for (int idx = width / 64 - 1; idx >= 0; --idx) {
-          fprintf(log_file, "%016" PRIx64, arr[idx]);
-        }
-      } else {
-        abort();
-      }
-      break;
-  }
-}
-
 static void commit_log_print_value(FILE *log_file, int width, uint64_t val)
 {
   commit_log_print_value(log_file, width, &val);
@@ -66,6 +35,11 @@ const char* processor_t::get_symbol(uint64_t addr)
 
 static void commit_log_print_insn(processor_t *p, reg_t pc, insn_t insn)
 {
+  if (commit_trace_stream_t* trace = p->get_commit_trace()) {
+    trace->record(p, pc, insn);
+    return;
+  }
+
   FILE *log_file = p->get_log_file();
 
   auto& reg = p->get_state()->log_reg_write;
@@ -176,8 +150,15 @@ static inline reg_t execute_insn(processor_t* p, reg_t pc, insn_fetch_t fetch)
   commit_log_stash_privilege(p);
   reg_t npc;
 
+#ifdef RISCV_ENABLE_COMMITLOG
   try {
+#endif
     npc = fetch.func(p, fetch.insn, pc);
+#ifdef RISCV_ENABLE_COMMITLOG
+    p->VU.log_writes();
+#endif
+    if (npc == PC_TRAP)
+      return npc;
     if (npc != PC_SERIALIZE_BEFORE) {
 
 #ifdef RISCV_ENABLE_COMMITLOG
@@ -188,13 +169,9 @@ static inline reg_t execute_insn(processor_t* p, reg_t pc, insn_fetch_t fetch)
 
      }
 #ifdef RISCV_ENABLE_COMMITLOG
-  } catch (wait_for_interrupt_t &t) {
-      if (p->get_log_commits_enabled()) {
-        commit_log_print_insn(p, pc, fetch.insn);
-      }
-      throw;
   } catch(mem_trap_t& t) {
       //handle segfault in midlle of vector load/store
+      p->VU.log_writes();
       if (p->get_log_commits_enabled()) {
         for (auto item : p->get_state()->log_reg_write) {
           if ((item.first & 3) == 3) {
@@ -204,10 +181,8 @@ static inline reg_t execute_insn(processor_t* p, reg_t pc, insn_fetch_t fetch)
         }
       }
       throw;
-#endif
-  } catch(...) {
-    throw;
   }
+#endif
   p->update_histogram(pc);
 
   return npc;
@@ -243,6 +218,8 @@ void processor_t::step(size_t n)
          case PC_SERIALIZE_BEFORE: state.serialized = true; break; \
          case PC_SERIALIZE_AFTER: ++instret; break; \
          case PC_SERIALIZE_WFI: n = ++instret; break; \
+         /* a returned trap ends the step, as a thrown one does */ \
+         case PC_TRAP: take_returned_trap(state.pc); n = instret; break; \
          default: abort(); \
        } \
        pc = state.pc; \
@@ -252,10 +229,15 @@ void processor_t::step(size_t n)
        instret++; \
      }
 
+    if (reg_t interrupt = pending_interrupt()) {
+      trap_t t(interrupt);
+      take_step_trap(t, pc);
+      n = instret;
+      continue;
+    }
+
     try
     {
-      take_pending_interrupt();
-
       if (unlikely(slow_path()))
       {
         // Main simulation loop, slow path.
@@ -283,14 +265,15 @@ void processor_t::step(size_t n)
       }
       else while (instret < n)
       {
-        // Main simulation loop, fast path.
-        for (auto ic_entry = _mmu->access_icache(pc); ; ) {
-          auto fetch = ic_entry->data;
-          pc = execute_insn(this, pc, fetch);
-          ic_entry = ic_entry->next;
-          if (unlikely(ic_entry->tag != pc))
+        // Main simulation loop, fast path.  Run a decoded block until it
+        // ends, control leaves it, or the instruction budget runs out.
+        auto block = _mmu->access_icache(pc);
+        size_t length = std::min(block->length, n - instret);
+        for (size_t i = 0; ; ) {
+          pc = execute_insn(this, pc, block->insns[i].data);
+          if (unlikely(++i == length))
             break;
-          if (unlikely(instret + 1 == n))
+          if (unlikely(block->insns[i].tag != pc))
             break;
           instret++;
           state.pc = pc;
@@ -301,13 +284,10 @@ void processor_t::step(size_t n)
     }
     catch(trap_t& t)
     {
-      take_trap(t, pc);
+      take_step_trap(t, pc);
+      // A trap ends the step, so the harts interleave, and see the clock and
+      // HTIF, at the same points whether or not the trap was thrown.
       n = instret;
-
-      if (unlikely(state.single_step == state.STEP_STEPPED)) {
-        state.single_step = state.STEP_NONE;
-        enter_debug_mode(DCSR_CAUSE_STEP);
-      }
     }
     catch (trigger_matched_t& t)
     {
@@ -337,16 +317,6 @@ void processor_t::step(size_t n)
           abort();
       }
     }
-    catch (wait_for_interrupt_t &t)
-    {
-      // Return to the outer simulation loop, which gives other devices/harts a
-      // chance to generate interrupts.
-      //
-      // In the debug ROM this prevents us from wasting time looping, but also
-      // allows us to switch to other threads only once per idle loop in case
-      // there is activity.
-      n = ++instret;
-    }
 
     state.minstret += instret;
     n -= instret;
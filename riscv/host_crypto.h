@@ -0,0 +1,64 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_HOST_CRYPTO_H
+#define _RISCV_HOST_CRYPTO_H
+
+// The RV64 AES instructions and carry-less multiplies on the host's AES-NI
+// and PCLMULQDQ instructions, where the host has them.  The AES round
+// instructions operate on the whole 128-bit state in the same byte order as
+// RISC-V's rs2:rs1 pair, and with a zero round key leave just the round
+// function, of which RISC-V wants the low 64 bits.
+
+#include <cstdint>
+
+#if defined(__x86_64__)
+
+#include <wmmintrin.h>
+
+#define HOST_AES_SUPPORTED __builtin_cpu_supports("aes")
+#define HOST_CLMUL_SUPPORTED __builtin_cpu_supports("pclmul")
+
+#define host_aes64_func(name, round) \
+  __attribute__((target("aes"))) \
+  static inline uint64_t host_##name(uint64_t rs1, uint64_t rs2) \
+  { \
+    __m128i state = _mm_set_epi64x(rs2, rs1); \
+    return _mm_cvtsi128_si64(round(state, _mm_setzero_si128())); \
+  }
+
+host_aes64_func(aes64es, _mm_aesenclast_si128)
+host_aes64_func(aes64esm, _mm_aesenc_si128)
+host_aes64_func(aes64ds, _mm_aesdeclast_si128)
+host_aes64_func(aes64dsm, _mm_aesdec_si128)
+
+__attribute__((target("aes")))
+static inline uint64_t host_aes64im(uint64_t rs1)
+{
+  return _mm_cvtsi128_si64(_mm_aesimc_si128(_mm_cvtsi64_si128(rs1)));
+}
+
+// Returns the low 64 bits of the carry-less product of a and b, and puts
+// the high 64 bits in *hi.
+__attribute__((target("pclmul")))
+static inline uint64_t host_clmul(uint64_t a, uint64_t b, uint64_t* hi)
+{
+  __m128i prod = _mm_clmulepi64_si128(_mm_cvtsi64_si128(a), _mm_cvtsi64_si128(b), 0);
+  *hi = _mm_cvtsi128_si64(_mm_unpackhi_epi64(prod, prod));
+  return _mm_cvtsi128_si64(prod);
+}
+
+#else
+
+#define HOST_AES_SUPPORTED false
+#define HOST_CLMUL_SUPPORTED false
+
+static inline uint64_t host_aes64es(uint64_t, uint64_t) { return 0; }
+static inline uint64_t host_aes64esm(uint64_t, uint64_t) { return 0; }
+static inline uint64_t host_aes64ds(uint64_t, uint64_t) { return 0; }
+static inline uint64_t host_aes64dsm(uint64_t, uint64_t) { return 0; }
+static inline uint64_t host_aes64im(uint64_t) { return 0; }
+static inline uint64_t host_clmul(uint64_t, uint64_t, uint64_t*) { return 0; }
+
+#endif
+
+#endif
@@ -0,0 +1,425 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_HOST_FP_H
+#define _RISCV_HOST_FP_H
+
+// Scalar F and D arithmetic on the host FPU.  In round-to-nearest-even mode
+// the host's IEEE arithmetic rounds exactly like softfloat, so for operands
+// and results well inside the normal range the only flag left to compute is
+// inexact, which an exact post-check recovers far more cheaply than a round
+// trip through the host's floating-point status register:
+//
+//  - sums are checked with the error-free TwoSum transformation;
+//  - double products, quotients and square roots are checked by multiplying
+//    significands in 128-bit integer arithmetic;
+//  - single-precision operations are done in double, where products are
+//    exact and the final rounding to single is known to be innocuous, and
+//    checked there;
+//  - double fused multiply-adds use the host FMA and the Boldo-Muller ErrFma
+//    transformation.
+//
+// NaNs, infinities, zeros, subnormals, possible overflow or underflow, and
+// the other rounding modes all go to softfloat.
+
+#include "common.h"
+#include "softfloat.h"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+static inline float host_fp_value(float32_t a)
+{
+  float f;
+  memcpy(&f, &a.v, sizeof(f));
+  return f;
+}
+
+static inline double host_fp_value(float64_t a)
+{
+  double d;
+  memcpy(&d, &a.v, sizeof(d));
+  return d;
+}
+
+static inline float32_t host_fp_result(float f)
+{
+  float32_t r;
+  memcpy(&r.v, &f, sizeof(f));
+  return r;
+}
+
+static inline float64_t host_fp_result(double d)
+{
+  float64_t r;
+  memcpy(&r.v, &d, sizeof(d));
+  return r;
+}
+
+#if FLT_EVAL_METHOD == 0 && defined(__SIZEOF_INT128__)
+
+// Significand of a normal double, with the implicit bit.
+static inline unsigned __int128 host_fp_sig(double d)
+{
+  return (host_fp_result(d).v & ((UINT64_C(1) << 52) - 1)) | (UINT64_C(1) << 52);
+}
+
+// True if a product of two significands is the significand of r shifted
+// left, i.e. if the 106-bit product was rounded to r without loss.
+static inline bool host_fp_sig_exact(unsigned __int128 prod, double r)
+{
+  return prod == host_fp_sig(r) << (52 + (int)(prod >> 105));
+}
+
+static inline bool host_fp_normal(double d)
+{
+  return fabs(d) > DBL_MIN && fabs(d) <= DBL_MAX;
+}
+
+static inline bool host_fp_normal(float f)
+{
+  return fabsf(f) > FLT_MIN && fabsf(f) <= FLT_MAX;
+}
+
+// Rounding error of s = a + b, exact unless s overflowed.
+static inline double host_fp_two_sum_err(double a, double b, double s)
+{
+  double bb = s - a;
+  return (a - (s - bb)) + (b - bb);
+}
+
+static inline float64_t host_fp_return(double r, bool inexact)
+{
+  if (inexact)
+    softfloat_exceptionFlags |= softfloat_flag_inexact;
+  return host_fp_result(r);
+}
+
+static inline float32_t host_fp_return(float r, bool inexact)
+{
+  if (inexact)
+    softfloat_exceptionFlags |= softfloat_flag_inexact;
+  return host_fp_result(r);
+}
+
+#if defined(__x86_64__)
+#define HOST_FMA_SUPPORTED __builtin_cpu_supports("fma")
+#define HOST_FMA_TARGET __attribute__((target("fma")))
+#elif defined(__FP_FAST_FMA)
+#define HOST_FMA_SUPPORTED true
+#define HOST_FMA_TARGET
+#else
+#define HOST_FMA_SUPPORTED false
+#define HOST_FMA_TARGET
+#endif
+
+#define HOST_FP_ENABLED (softfloat_roundingMode == softfloat_round_near_even)
+#define HOST_FMA_ENABLED (HOST_FP_ENABLED && HOST_FMA_SUPPORTED)
+
+#define host_f32_sum_func(name, op) \
+  static inline float32_t host_##name(float32_t a, float32_t b) \
+  { \
+    if (HOST_FP_ENABLED) { \
+      double x = host_fp_value(a), y = op(double)host_fp_value(b), s = x + y; \
+      float r = s; \
+      /* A sum of singles is exact when subnormal, so it cannot underflow. */ \
+      if (likely(fabsf(r) <= FLT_MAX)) \
+        return host_fp_return(r, host_fp_two_sum_err(x, y, s) != 0 || r != s); \
+    } \
+    return name(a, b); \
+  }
+
+host_f32_sum_func(f32_add, +)
+host_f32_sum_func(f32_sub, -)
+
+static inline float32_t host_f32_mul(float32_t a, float32_t b)
+{
+  if (HOST_FP_ENABLED) {
+    double p = (double)host_fp_value(a) * host_fp_value(b);
+    float r = p;
+    if (likely(fabs(p) > FLT_MIN && fabsf(r) <= FLT_MAX))
+      return host_fp_return(r, r != p);
+  }
+  return f32_mul(a, b);
+}
+
+static inline float32_t host_f32_div(float32_t a, float32_t b)
+{
+  if (HOST_FP_ENABLED) {
+    double x = host_fp_value(a), y = host_fp_value(b);
+    float r = x / y;
+    if (likely(host_fp_normal(r)))
+      return host_fp_return(r, (double)r * y != x);
+  }
+  return f32_div(a, b);
+}
+
+static inline float32_t host_f32_sqrt(float32_t a)
+{
+  if (HOST_FP_ENABLED) {
+    double x = host_fp_value(a);
+    float r = sqrt(x);
+    if (likely(fabsf(r) <= FLT_MAX))
+      return host_fp_return(r, (double)r * r != x);
+  }
+  return f32_sqrt(a);
+}
+
+static inline float32_t host_f32_mulAdd(float32_t a, float32_t b, float32_t c)
+{
+  if (HOST_FP_ENABLED) {
+    double p = (double)host_fp_value(a) * host_fp_value(b);
+    double z = host_fp_value(c), s = p + z, err = host_fp_two_sum_err(p, z, s);
+    float r = s;
+    // Rounding s to single is only wrong if s fell exactly on a midpoint.
+    bool midpoint = (host_fp_result(s).v & 0x1fffffff) == 0x10000000;
+    if (likely(fabs(s) > FLT_MIN && fabsf(r) <= FLT_MAX && (err == 0 || !midpoint)))
+      return host_fp_return(r, err != 0 || r != s);
+  }
+  return f32_mulAdd(a, b, c);
+}
+
+#define host_f64_sum_func(name, op) \
+  static inline float64_t host_##name(float64_t a, float64_t b) \
+  { \
+    if (HOST_FP_ENABLED) { \
+      double x = host_fp_value(a), y = op host_fp_value(b), r = x + y; \
+      if (likely(fabs(r) <= DBL_MAX)) \
+        return host_fp_return(r, host_fp_two_sum_err(x, y, r) != 0); \
+    } \
+    return name(a, b); \
+  }
+
+host_f64_sum_func(f64_add, +)
+host_f64_sum_func(f64_sub, -)
+
+static inline float64_t host_f64_mul(float64_t a, float64_t b)
+{
+  if (HOST_FP_ENABLED) {
+    double x = host_fp_value(a), y = host_fp_value(b), r = x * y;
+    if (likely(host_fp_normal(x) && host_fp_normal(y) && host_fp_normal(r))) {
+      unsigned __int128 prod = host_fp_sig(x) * host_fp_sig(y);
+      unsigned __int128 mask = ((unsigned __int128)1 << (52 + (int)(prod >> 105))) - 1;
+      return host_fp_return(r, (prod & mask) != 0);
+    }
+  }
+  return f64_mul(a, b);
+}
+
+static inline float64_t host_f64_div(float64_t a, float64_t b)
+{
+  if (HOST_FP_ENABLED) {
+    double x = host_fp_value(a), y = host_fp_value(b), r = x / y;
+    if (likely(host_fp_normal(x) && host_fp_normal(y) && host_fp_normal(r)))
+      return host_fp_return(r, !host_fp_sig_exact(host_fp_sig(r) * host_fp_sig(y), x));
+  }
+  return f64_div(a, b);
+}
+
+static inline float64_t host_f64_sqrt(float64_t a)
+{
+  if (HOST_FP_ENABLED) {
+    double x = host_fp_value(a);
+    if (likely(x > DBL_MIN && x <= DBL_MAX)) {
+      double r = sqrt(x);
+      return host_fp_return(r, !host_fp_sig_exact(host_fp_sig(r) * host_fp_sig(r), x));
+    }
+  }
+  return f64_sqrt(a);
+}
+
+HOST_FMA_TARGET
+static float64_t host_f64_fma(float64_t a, float64_t b, float64_t c)
+{
+  double x = host_fp_value(a), y = host_fp_value(b), z = host_fp_value(c);
+  double r = __builtin_fma(x, y, z);
+  double u1 = x * y, u2 = __builtin_fma(x, y, -u1);
+  // Keep the product and the result at least 2^62 above the smallest normal,
+  // far from underflow, so that x * y + z == r + gamma + alpha2 exactly.
+  const double min = DBL_MIN * 4611686018427387904.0;
+  if (likely(fabs(u1) > min && fabs(u1) <= DBL_MAX &&
+             fabs(r) > min && fabs(r) <= DBL_MAX)) {
+    double alpha1 = z + u2, alpha2 = host_fp_two_sum_err(z, u2, alpha1);
+    double beta1 = u1 + alpha1, beta2 = host_fp_two_sum_err(u1, alpha1, beta1);
+    double gamma = (beta1 - r) + beta2;
+    return host_fp_return(r, gamma + alpha2 != 0);
+  }
+  return f64_mulAdd(a, b, c);
+}
+
+static inline float64_t host_f64_mulAdd(float64_t a, float64_t b, float64_t c)
+{
+  if (HOST_FMA_ENABLED)
+    return host_f64_fma(a, b, c);
+  return f64_mulAdd(a, b, c);
+}
+
+// Batched kernels for the vector unit.  Each does HOST_FP_BATCH operations in
+// straight-line code the compiler can vectorize, and works out beside every
+// result its rounding error, which is nonzero if the result is inexact, and
+// a check, which is nonzero or NaN if softfloat has to do the element.  If
+// any element fails its check they return false without raising any flags;
+// otherwise they raise inexact if any result was inexact.
+
+#define HOST_FP_BATCH 8
+
+static const double host_fp_tiny = DBL_MIN * 4611686018427387904.0;
+static const double host_fp_huge = DBL_MAX / 268435456.0;
+
+static inline bool host_fp_batch_flags(const double* err, const double* check)
+{
+  uint64_t inexact = 0, fail = 0;
+  for (int j = 0; j < HOST_FP_BATCH; j++) {
+    uint64_t e, c;
+    memcpy(&e, &err[j], sizeof(e));
+    memcpy(&c, &check[j], sizeof(c));
+    // Shift out the sign bits so that -0 counts as zero.
+    inexact |= e << 1;
+    fail |= c << 1;
+  }
+  if (fail)
+    return false;
+  if (inexact)
+    softfloat_exceptionFlags |= softfloat_flag_inexact;
+  return true;
+}
+
+static inline bool host_fp_add_batch(float* r, const float* a, const float* b, const float*)
+{
+  double err[HOST_FP_BATCH], check[HOST_FP_BATCH];
+  for (int j = 0; j < HOST_FP_BATCH; j++) {
+    double x = a[j], y = b[j], s = x + y;
+    r[j] = s;
+    err[j] = fabs(host_fp_two_sum_err(x, y, s)) + fabs(s - r[j]);
+    check[j] = r[j] - r[j];
+  }
+  return host_fp_batch_flags(err, check);
+}
+
+static inline bool host_fp_add_batch(double* r, const double* a, const double* b, const double*)
+{
+  double err[HOST_FP_BATCH], check[HOST_FP_BATCH];
+  for (int j = 0; j < HOST_FP_BATCH; j++) {
+    double s = a[j] + b[j];
+    r[j] = s;
+    err[j] = host_fp_two_sum_err(a[j], b[j], s);
+    check[j] = s - s;
+  }
+  return host_fp_batch_flags(err, check);
+}
+
+static inline bool host_fp_mul_batch(float* r, const float* a, const float* b, const float*)
+{
+  double err[HOST_FP_BATCH], check[HOST_FP_BATCH];
+  for (int j = 0; j < HOST_FP_BATCH; j++) {
+    double p = (double)a[j] * b[j];
+    r[j] = p;
+    err[j] = p - r[j];
+    check[j] = (r[j] - r[j]) + ((fabs(p) < FLT_MIN) & (p != 0) ? 1.0 : 0.0);
+  }
+  return host_fp_batch_flags(err, check);
+}
+
+// Upper half of the significand of x, for Dekker's exact product.
+static inline double host_fp_split(double x)
+{
+  double t = 134217729.0 * x;
+  return t - (t - x);
+}
+
+static inline bool host_fp_mul_batch(double* r, const double* a, const double* b, const double*)
+{
+  double err[HOST_FP_BATCH], check[HOST_FP_BATCH];
+  for (int j = 0; j < HOST_FP_BATCH; j++) {
+    double x = a[j], y = b[j], p = x * y;
+    double xh = host_fp_split(x), xl = x - xh, yh = host_fp_split(y), yl = y - yh;
+    r[j] = p;
+    err[j] = ((xh * yh - p) + xh * yl + xl * yh) + xl * yl;
+    bool risky = (fabs(x) > host_fp_huge) | (fabs(y) > host_fp_huge) |
+                 (fabs(p) > host_fp_huge) |
+                 ((fabs(p) < host_fp_tiny) & (x != 0) & (y != 0));
+    check[j] = (p - p) + (risky ? 1.0 : 0.0);
+  }
+  return host_fp_batch_flags(err, check);
+}
+
+static inline bool host_fp_mulAdd_batch(float* r, const float* a, const float* b, const float* c)
+{
+  double err[HOST_FP_BATCH], check[HOST_FP_BATCH];
+  for (int j = 0; j < HOST_FP_BATCH; j++) {
+    double p = (double)a[j] * b[j], z = c[j], s = p + z;
+    double e = host_fp_two_sum_err(p, z, s);
+    r[j] = s;
+    // If s was rounded it must not be rounded again from a midpoint, which
+    // is the case if it lies halfway to the next single along.
+    double d = s - r[j], next = r[j] + 2 * d;
+    bool midpoint = (d != 0) & ((float)next == next);
+    bool risky = ((e != 0) & midpoint) | ((fabs(s) < FLT_MIN) & (s != 0));
+    err[j] = fabs(d) + fabs(e);
+    check[j] = (r[j] - r[j]) + (risky ? 1.0 : 0.0);
+  }
+  return host_fp_batch_flags(err, check);
+}
+
+// This one is not inlined, so it works on local copies of the operands,
+// which it knows are not aliased.
+HOST_FMA_TARGET
+static bool host_fp_fma_batch(double* r, const double* a, const double* b, const double* c)
+{
+  double x[HOST_FP_BATCH], y[HOST_FP_BATCH], z[HOST_FP_BATCH], s[HOST_FP_BATCH];
+  double err[HOST_FP_BATCH], check[HOST_FP_BATCH];
+  memcpy(x, a, sizeof(x));
+  memcpy(y, b, sizeof(y));
+  memcpy(z, c, sizeof(z));
+  for (int j = 0; j < HOST_FP_BATCH; j++) {
+    s[j] = __builtin_fma(x[j], y[j], z[j]);
+    double u1 = x[j] * y[j], u2 = __builtin_fma(x[j], y[j], -u1);
+    double alpha1 = z[j] + u2, alpha2 = host_fp_two_sum_err(z[j], u2, alpha1);
+    double beta1 = u1 + alpha1, beta2 = host_fp_two_sum_err(u1, alpha1, beta1);
+    err[j] = ((beta1 - s[j]) + beta2) + alpha2;
+    // A zero product leaves z exact, however small.
+    bool risky = ((fabs(u1) < host_fp_tiny) | (fabs(s[j]) < host_fp_tiny)) &
+                 (x[j] != 0) & (y[j] != 0);
+    check[j] = (s[j] - s[j]) + (u1 - u1) + (risky ? 1.0 : 0.0);
+  }
+  memcpy(r, s, sizeof(s));
+  return host_fp_batch_flags(err, check);
+}
+
+static inline bool host_fp_mulAdd_batch(double* r, const double* a, const double* b, const double* c)
+{
+  return HOST_FMA_SUPPORTED && host_fp_fma_batch(r, a, b, c);
+}
+
+#else
+
+#define HOST_FP_ENABLED false
+#define HOST_FMA_ENABLED false
+
+#define host_f32_add f32_add
+#define host_f32_sub f32_sub
+#define host_f32_mul f32_mul
+#define host_f32_div f32_div
+#define host_f32_sqrt f32_sqrt
+#define host_f32_mulAdd f32_mulAdd
+#define host_f64_add f64_add
+#define host_f64_sub f64_sub
+#define host_f64_mul f64_mul
+#define host_f64_div f64_div
+#define host_f64_sqrt f64_sqrt
+#define host_f64_mulAdd f64_mulAdd
+
+#define HOST_FP_BATCH 8
+
+#define host_fp_batch_func(name) \
+  template<class T> static inline bool host_fp_##name##_batch(T*, const T*, const T*, const T*) \
+  { \
+    return false; \
+  }
+
+host_fp_batch_func(add)
+host_fp_batch_func(mul)
+host_fp_batch_func(mulAdd)
+
+#endif
+
+#endif
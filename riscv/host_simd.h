@@ -0,0 +1,113 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_HOST_SIMD_H
+#define _RISCV_HOST_SIMD_H
+
+// Saturating packed-SIMD adds, subtracts and Q-format multiplies on the
+// host's SSE2 unit.  Each works on all the lanes of a 64-bit register at
+// once, and sets sat if any lane saturated.
+//
+// Only x86-64 has kernels: other hosts, AArch64 included, keep the P_LOOP
+// bodies, since a NEON version couldn't be built or checked against them
+// here.  The pack and 32-bit multiply-high instructions stay scalar on every
+// host: with only shifts and masks per lane, or at most two lanes, SSE2
+// versions measured within noise of the lane loops (pk*16) or slower (smmul,
+// which SSE2 can only do as an unsigned multiply plus corrections).
+
+#include <cstdint>
+
+#if defined(__SSE2__)
+
+#include <emmintrin.h>
+
+#define HOST_SIMD_SUPPORTED true
+
+#define host_simd_sat_func(name, sat_op, wrap_op, cmp_op) \
+  static inline uint64_t host_##name(uint64_t a, uint64_t b, bool& sat) \
+  { \
+    __m128i x = _mm_cvtsi64_si128(a), y = _mm_cvtsi64_si128(b); \
+    __m128i r = sat_op(x, y); \
+    sat = _mm_movemask_epi8(cmp_op(r, wrap_op(x, y))) != 0xffff; \
+    return _mm_cvtsi128_si64(r); \
+  }
+
+host_simd_sat_func(kadd8, _mm_adds_epi8, _mm_add_epi8, _mm_cmpeq_epi8)
+host_simd_sat_func(kadd16, _mm_adds_epi16, _mm_add_epi16, _mm_cmpeq_epi16)
+host_simd_sat_func(ksub8, _mm_subs_epi8, _mm_sub_epi8, _mm_cmpeq_epi8)
+host_simd_sat_func(ksub16, _mm_subs_epi16, _mm_sub_epi16, _mm_cmpeq_epi16)
+host_simd_sat_func(ukadd8, _mm_adds_epu8, _mm_add_epi8, _mm_cmpeq_epi8)
+host_simd_sat_func(ukadd16, _mm_adds_epu16, _mm_add_epi16, _mm_cmpeq_epi16)
+host_simd_sat_func(uksub8, _mm_subs_epu8, _mm_sub_epi8, _mm_cmpeq_epi8)
+host_simd_sat_func(uksub16, _mm_subs_epu16, _mm_sub_epi16, _mm_cmpeq_epi16)
+
+// khm16 and khmx16: (a * b) >> 15 from the low and high halves of the
+// products.  Only INT16_MIN * INT16_MIN overflows, giving INT16_MIN, which
+// adding the all-ones overflow mask turns into INT16_MAX.
+static inline uint64_t host_khm16_lanes(__m128i x, __m128i y, bool& sat)
+{
+  __m128i lo = _mm_mullo_epi16(x, y), hi = _mm_mulhi_epi16(x, y);
+  __m128i r = _mm_or_si128(_mm_slli_epi16(hi, 1), _mm_srli_epi16(lo, 15));
+  __m128i min = _mm_set1_epi16(INT16_MIN);
+  __m128i ov = _mm_and_si128(_mm_cmpeq_epi16(x, min), _mm_cmpeq_epi16(y, min));
+  sat = _mm_movemask_epi8(ov) != 0;
+  return _mm_cvtsi128_si64(_mm_add_epi16(r, ov));
+}
+
+static inline uint64_t host_khm16(uint64_t a, uint64_t b, bool& sat)
+{
+  return host_khm16_lanes(_mm_cvtsi64_si128(a), _mm_cvtsi64_si128(b), sat);
+}
+
+static inline uint64_t host_khmx16(uint64_t a, uint64_t b, bool& sat)
+{
+  __m128i y = _mm_shufflelo_epi16(_mm_cvtsi64_si128(b), _MM_SHUFFLE(2, 3, 0, 1));
+  return host_khm16_lanes(_mm_cvtsi64_si128(a), y, sat);
+}
+
+// khm8 and khmx8: sign-extend the bytes to 16 bits, where the products are
+// exact, and let the signed pack back to bytes saturate the one overflowing
+// result, 128, to INT8_MAX.
+static inline uint64_t host_khm8_lanes(__m128i x, __m128i y, bool& sat)
+{
+  x = _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8);
+  y = _mm_srai_epi16(_mm_unpacklo_epi8(y, y), 8);
+  __m128i r = _mm_srai_epi16(_mm_mullo_epi16(x, y), 7);
+  sat = _mm_movemask_epi8(_mm_cmpeq_epi16(r, _mm_set1_epi16(128))) != 0;
+  return _mm_cvtsi128_si64(_mm_packs_epi16(r, r));
+}
+
+static inline uint64_t host_khm8(uint64_t a, uint64_t b, bool& sat)
+{
+  return host_khm8_lanes(_mm_cvtsi64_si128(a), _mm_cvtsi64_si128(b), sat);
+}
+
+static inline uint64_t host_khmx8(uint64_t a, uint64_t b, bool& sat)
+{
+  __m128i y = _mm_cvtsi64_si128(b);
+  y = _mm_or_si128(_mm_slli_epi16(y, 8), _mm_srli_epi16(y, 8));
+  return host_khm8_lanes(_mm_cvtsi64_si128(a), y, sat);
+}
+
+#else
+
+#define HOST_SIMD_SUPPORTED false
+
+#define host_simd_sat_func(name) \
+  static inline uint64_t host_##name(uint64_t, uint64_t, bool&) { return 0; }
+
+host_simd_sat_func(kadd8)
+host_simd_sat_func(kadd16)
+host_simd_sat_func(ksub8)
+host_simd_sat_func(ksub16)
+host_simd_sat_func(ukadd8)
+host_simd_sat_func(ukadd16)
+host_simd_sat_func(uksub8)
+host_simd_sat_func(uksub16)
+host_simd_sat_func(khm8)
+host_simd_sat_func(khm16)
+host_simd_sat_func(khmx8)
+host_simd_sat_func(khmx16)
+
+#endif
+
+#endif
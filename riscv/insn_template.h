@@ -5,5 +5,8 @@
 #include "softfloat.h"
 #include "internals.h"
 #include "specialize.h"
+#include "host_crypto.h"
+#include "host_fp.h"
+#include "host_simd.h"
 #include "tracer.h"
 #include <assert.h>
@@ -4,13 +4,16 @@
 require_rv64;
 require_extension(EXT_ZKND);
 
-uint32_t col_0 = RS1 & 0xFFFFFFFF;
-uint32_t col_1 = RS1 >> 32       ;
+if (HOST_AES_SUPPORTED) {
+  WRITE_RD(host_aes64im(RS1));
+} else {
+  uint32_t col_0 = RS1 & 0xFFFFFFFF;
+  uint32_t col_1 = RS1 >> 32       ;
 
-         col_0 = AES_INVMIXCOLUMN(col_0);
-         col_1 = AES_INVMIXCOLUMN(col_1);
+           col_0 = AES_INVMIXCOLUMN(col_0);
+           col_1 = AES_INVMIXCOLUMN(col_1);
 
-uint64_t result= ((uint64_t)col_1 << 32) | col_0;
-
-WRITE_RD(result);
+  uint64_t result= ((uint64_t)col_1 << 32) | col_0;
 
+  WRITE_RD(result);
+}
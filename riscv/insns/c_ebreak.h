@@ -1,2 +1,2 @@
 require_extension('C');
-throw trap_breakpoint(pc);
+return_trap(CAUSE_BREAKPOINT);
@@ -1,6 +1,11 @@
 require_either_extension(EXT_ZBC, EXT_ZBKC);
 reg_t a = zext_xlen(RS1), b = zext_xlen(RS2), x = 0;
-for (int i = 0; i < xlen; i++)
-  if ((b >> i) & 1)
-    x ^= a << i;
+if (HOST_CLMUL_SUPPORTED) {
+  uint64_t hi;
+  x = host_clmul(a, b, &hi);
+} else {
+  for (int i = 0; i < xlen; i++)
+    if ((b >> i) & 1)
+      x ^= a << i;
+}
 WRITE_RD(sext_xlen(x));
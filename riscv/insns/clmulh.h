@@ -1,6 +1,11 @@
 require_either_extension(EXT_ZBC, EXT_ZBKC);
 reg_t a = zext_xlen(RS1), b = zext_xlen(RS2), x = 0;
-for (int i = 1; i < xlen; i++)
-  if ((b >> i) & 1)
-    x ^= a >> (xlen-i);
+if (HOST_CLMUL_SUPPORTED) {
+  uint64_t hi, lo = host_clmul(a, b, &hi);
+  x = xlen == 64 ? hi : lo >> 32;
+} else {
+  for (int i = 1; i < xlen; i++)
+    if ((b >> i) & 1)
+      x ^= a >> (xlen-i);
+}
 WRITE_RD(sext_xlen(x));
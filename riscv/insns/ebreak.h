@@ -1 +1 @@
-throw trap_breakpoint(pc);
+return_trap(CAUSE_BREAKPOINT);
@@ -1,11 +1,12 @@
 switch (STATE.prv)
 {
-  case PRV_U: throw trap_user_ecall();
+  case PRV_U: return_trap(CAUSE_USER_ECALL); break;
   case PRV_S:
     if (STATE.v)
-      throw trap_virtual_supervisor_ecall();
+      return_trap(CAUSE_VIRTUAL_SUPERVISOR_ECALL);
     else
-      throw trap_supervisor_ecall();
-  case PRV_M: throw trap_machine_ecall();
+      return_trap(CAUSE_SUPERVISOR_ECALL);
+    break;
+  case PRV_M: return_trap(CAUSE_MACHINE_ECALL); break;
   default: abort();
 }
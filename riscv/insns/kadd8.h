@@ -1,5 +1,9 @@
-P_LOOP(8, {
-  bool sat = false;
-  pd = (sat_add<int8_t, uint8_t>(ps1, ps2, sat));
-  P_SET_OV(sat);
-})
\ No newline at end of file
+if (HOST_SIMD_SUPPORTED) {
+  P_SIMD_SAT(kadd8)
+} else {
+  P_LOOP(8, {
+    bool sat = false;
+    pd = (sat_add<int8_t, uint8_t>(ps1, ps2, sat));
+    P_SET_OV(sat);
+  })
+}
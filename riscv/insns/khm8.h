@@ -1,8 +1,12 @@
-P_LOOP(8, {
-  if ((ps1 != INT8_MIN) | (ps2 != INT8_MIN)) {
-    pd = (ps1 * ps2) >> 7;
-  } else {
-    pd = INT8_MAX;
-    P_SET_OV(1);
-  }
-})
\ No newline at end of file
+if (HOST_SIMD_SUPPORTED) {
+  P_SIMD_SAT(khm8)
+} else {
+  P_LOOP(8, {
+    if ((ps1 != INT8_MIN) | (ps2 != INT8_MIN)) {
+      pd = (ps1 * ps2) >> 7;
+    } else {
+      pd = INT8_MAX;
+      P_SET_OV(1);
+    }
+  })
+}
@@ -1,5 +1,9 @@
-P_LOOP(16, {
-  bool sat = false;
-  pd = (sat_sub<int16_t, uint16_t>(ps1, ps2, sat));
-  P_SET_OV(sat);
-})
\ No newline at end of file
+if (HOST_SIMD_SUPPORTED) {
+  P_SIMD_SAT(ksub16)
+} else {
+  P_LOOP(16, {
+    bool sat = false;
+    pd = (sat_sub<int16_t, uint16_t>(ps1, ps2, sat));
+    P_SET_OV(sat);
+  })
+}
@@ -1,5 +1,5 @@
 require_extension('A');
 require_rv64;
 auto res = MMU.load_int64(RS1, true);
-MMU.acquire_load_reservation(RS1);
+MMU.acquire_load_reservation(RS1, res);
 WRITE_RD(res);
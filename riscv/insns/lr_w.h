@@ -1,4 +1,4 @@
 require_extension('A');
 auto res = MMU.load_int32(RS1, true);
-MMU.acquire_load_reservation(RS1);
+MMU.acquire_load_reservation(RS1, res);
 WRITE_RD(res);
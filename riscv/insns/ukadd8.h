@@ -1,5 +1,9 @@
-P_ULOOP(8, {
-  bool sat = false;
-  pd = (sat_addu<uint8_t>(ps1, ps2, sat));
-  P_SET_OV(sat);
-})
\ No newline at end of file
+if (HOST_SIMD_SUPPORTED) {
+  P_SIMD_SAT(ukadd8)
+} else {
+  P_ULOOP(8, {
+    bool sat = false;
+    pd = (sat_addu<uint8_t>(ps1, ps2, sat));
+    P_SET_OV(sat);
+  })
+}
@@ -1,3 +1,3 @@
 P_MUL_CROSS_ULOOP(16, {
-  pd = ps1 * ps2;
+  pd = (uint32_t)ps1 * ps2;
 })
\ No newline at end of file
@@ -1,11 +1,11 @@
 // vfadd.vv vd, vs2, vs1
-VI_VFP_VV_LOOP
-({
+VI_VFP_VV_LOOP_BATCH(add, vs1, vs2, 0,
+{
   vd = f16_add(vs1, vs2);
 },
 {
-  vd = f32_add(vs1, vs2);
+  vd = host_f32_add(vs1, vs2);
 },
 {
-  vd = f64_add(vs1, vs2);
+  vd = host_f64_add(vs1, vs2);
 })
@@ -1,11 +1,11 @@
 // vfmacc.vf vd, rs1, vs2, vm    # vd[i] = +(vs2[i] * x[rs1]) + vd[i]
-VI_VFP_VF_LOOP
-({
+VI_VFP_VF_LOOP_BATCH(mulAdd, rs1, vs2, vd,
+{
   vd = f16_mulAdd(rs1, vs2, vd);
 },
 {
-  vd = f32_mulAdd(rs1, vs2, vd);
+  vd = host_f32_mulAdd(rs1, vs2, vd);
 },
 {
-  vd = f64_mulAdd(rs1, vs2, vd);
+  vd = host_f64_mulAdd(rs1, vs2, vd);
 })
@@ -1,11 +1,11 @@
 // vfmacc.vv vd, rs1, vs2, vm    # vd[i] = +(vs2[i] * vs1[i]) + vd[i]
-VI_VFP_VV_LOOP
-({
+VI_VFP_VV_LOOP_BATCH(mulAdd, vs1, vs2, vd,
+{
   vd = f16_mulAdd(vs1, vs2, vd);
 },
 {
-  vd = f32_mulAdd(vs1, vs2, vd);
+  vd = host_f32_mulAdd(vs1, vs2, vd);
 },
 {
-  vd = f64_mulAdd(vs1, vs2, vd);
+  vd = host_f64_mulAdd(vs1, vs2, vd);
 })
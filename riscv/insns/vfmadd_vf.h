@@ -1,11 +1,11 @@
 // vfmadd: vd[i] = +(vd[i] * f[rs1]) + vs2[i]
-VI_VFP_VF_LOOP
-({
+VI_VFP_VF_LOOP_BATCH(mulAdd, vd, rs1, vs2,
+{
   vd = f16_mulAdd(vd, rs1, vs2);
 },
 {
-  vd = f32_mulAdd(vd, rs1, vs2);
+  vd = host_f32_mulAdd(vd, rs1, vs2);
 },
 {
-  vd = f64_mulAdd(vd, rs1, vs2);
+  vd = host_f64_mulAdd(vd, rs1, vs2);
 })
@@ -1,11 +1,11 @@
 // vfmsac: vd[i] = +(vs1[i] * vs2[i]) - vd[i]
-VI_VFP_VV_LOOP
-({
+VI_VFP_VV_LOOP_BATCH(mulAdd, vs1, vs2, -vd,
+{
   vd = f16_mulAdd(vs1, vs2, f16(vd.v ^ F16_SIGN));
 },
 {
-  vd = f32_mulAdd(vs1, vs2, f32(vd.v ^ F32_SIGN));
+  vd = host_f32_mulAdd(vs1, vs2, f32(vd.v ^ F32_SIGN));
 },
 {
-  vd = f64_mulAdd(vs1, vs2, f64(vd.v ^ F64_SIGN));
+  vd = host_f64_mulAdd(vs1, vs2, f64(vd.v ^ F64_SIGN));
 })
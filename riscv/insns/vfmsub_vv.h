@@ -1,11 +1,11 @@
 // vfmsub: vd[i] = +(vd[i] * vs1[i]) - vs2[i]
-VI_VFP_VV_LOOP
-({
+VI_VFP_VV_LOOP_BATCH(mulAdd, vd, vs1, -vs2,
+{
   vd = f16_mulAdd(vd, vs1, f16(vs2.v ^ F16_SIGN));
 },
 {
-  vd = f32_mulAdd(vd, vs1, f32(vs2.v ^ F32_SIGN));
+  vd = host_f32_mulAdd(vd, vs1, f32(vs2.v ^ F32_SIGN));
 },
 {
-  vd = f64_mulAdd(vd, vs1, f64(vs2.v ^ F64_SIGN));
+  vd = host_f64_mulAdd(vd, vs1, f64(vs2.v ^ F64_SIGN));
 })
@@ -1,11 +1,11 @@
 // vfmul.vf vd, vs2, rs1, vm
-VI_VFP_VF_LOOP
-({
+VI_VFP_VF_LOOP_BATCH(mul, vs2, rs1, 0,
+{
   vd = f16_mul(vs2, rs1);
 },
 {
-  vd = f32_mul(vs2, rs1);
+  vd = host_f32_mul(vs2, rs1);
 },
 {
-  vd = f64_mul(vs2, rs1);
+  vd = host_f64_mul(vs2, rs1);
 })
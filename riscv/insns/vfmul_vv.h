@@ -1,11 +1,11 @@
 // vfmul.vv vd, vs1, vs2, vm
-VI_VFP_VV_LOOP
-({
+VI_VFP_VV_LOOP_BATCH(mul, vs1, vs2, 0,
+{
   vd = f16_mul(vs1, vs2);
 },
 {
-  vd = f32_mul(vs1, vs2);
+  vd = host_f32_mul(vs1, vs2);
 },
 {
-  vd = f64_mul(vs1, vs2);
+  vd = host_f64_mul(vs1, vs2);
 })
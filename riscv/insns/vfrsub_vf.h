@@ -1,11 +1,11 @@
 // vfsub.vf vd, vs2, rs1
-VI_VFP_VF_LOOP
-({
+VI_VFP_VF_LOOP_BATCH(add, rs1, -vs2, 0,
+{
   vd = f16_sub(rs1, vs2);
 },
 {
-  vd = f32_sub(rs1, vs2);
+  vd = host_f32_sub(rs1, vs2);
 },
 {
-  vd = f64_sub(rs1, vs2);
+  vd = host_f64_sub(rs1, vs2);
 })
@@ -1,11 +1,11 @@
 // vfsub.vf vd, vs2, rs1
-VI_VFP_VF_LOOP
-({
+VI_VFP_VF_LOOP_BATCH(add, vs2, -rs1, 0,
+{
   vd = f16_sub(vs2, rs1);
 },
 {
-  vd = f32_sub(vs2, rs1);
+  vd = host_f32_sub(vs2, rs1);
 },
 {
-  vd = f64_sub(vs2, rs1);
+  vd = host_f64_sub(vs2, rs1);
 })
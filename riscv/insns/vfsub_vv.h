@@ -1,11 +1,11 @@
 // vfsub.vv vd, vs2, vs1
-VI_VFP_VV_LOOP
-({
+VI_VFP_VV_LOOP_BATCH(add, vs2, -vs1, 0,
+{
   vd = f16_sub(vs2, vs1);
 },
 {
-  vd = f32_sub(vs2, vs1);
+  vd = host_f32_sub(vs2, vs1);
 },
 {
-  vd = f64_sub(vs2, vs1);
+  vd = host_f64_sub(vs2, vs1);
 })
@@ -4,40 +4,183 @@
 #include "arith.h"
 #include "simif.h"
 #include "processor.h"
+#include <iostream>
+#include <iomanip>
 
 mmu_t::mmu_t(simif_t* sim, processor_t* proc)
  : sim(sim), proc(proc),
 #ifdef RISCV_ENABLE_DUAL_ENDIAN
   target_big_endian(false),
 #endif
+  concurrent_harts(false),
+  tlb_data(NULL),
+  tlb_insn_tag(NULL),
+  tlb_load_tag(NULL),
+  tlb_store_tag(NULL),
+  tlb_hits(),
+  tlb_misses(),
+  tlb_stats(false),
+  walk_cache(),
+  walk_cache_asids(0),
+  walk_count(0),
+  walk_levels_read(0),
+  walk_levels_skipped(0),
   check_triggers_fetch(false),
   check_triggers_load(false),
   check_triggers_store(false),
   matched_trigger(NULL)
 {
-  flush_tlb();
+  // no page table walk may match a walk cache entry before the first flush
+  for (auto& entry : walk_cache)
+    entry.tag = -1;
+  configure_tlb(TLB_DEFAULT_SETS, TLB_DEFAULT_WAYS);
   yield_load_reservation();
 }
 
 mmu_t::~mmu_t()
 {
+  delete [] tlb_data;
+  delete [] tlb_insn_tag;
+  delete [] tlb_load_tag;
+  delete [] tlb_store_tag;
+}
+
+void mmu_t::configure_tlb(size_t sets, size_t ways)
+{
+  assert(sets > 0 && (sets & (sets - 1)) == 0 && ways > 0);
+
+  delete [] tlb_data;
+  delete [] tlb_insn_tag;
+  delete [] tlb_load_tag;
+  delete [] tlb_store_tag;
+
+  tlb_sets = sets;
+  tlb_ways = ways;
+  tlb_set_mask = sets - 1;
+  tlb_data = new tlb_entry_t[sets * ways];
+  tlb_insn_tag = new reg_t[sets * ways];
+  tlb_load_tag = new reg_t[sets * ways];
+  tlb_store_tag = new reg_t[sets * ways];
+
+  flush_tlb();
+}
+
+void mmu_t::print_tlb_stats()
+{
+  static const char* const names[] = {"Load", "Store", "Fetch"};
+
+  std::cout << std::setprecision(3) << std::fixed;
+  for (int type = LOAD; type <= FETCH; type++) {
+    uint64_t accesses = tlb_hits[type] + tlb_misses[type];
+    if (accesses == 0)
+      continue;
+
+    float mr = 100.0f * tlb_misses[type] / accesses;
+    std::string name = "TLB" + std::to_string(proc ? proc->get_id() : 0) + " " + names[type];
+    std::cout << name << " Hits:       " << tlb_hits[type] << std::endl;
+    std::cout << name << " Misses:     " << tlb_misses[type] << std::endl;
+    std::cout << name << " Miss Rate:  " << mr << '%' << std::endl;
+  }
+
+  if (walk_count == 0)
+    return;
+
+  std::string name = "PTW" + std::to_string(proc ? proc->get_id() : 0);
+  std::cout << name << " Walks:              " << walk_count << std::endl;
+  std::cout << name << " Levels Read:        " << walk_levels_read << std::endl;
+  std::cout << name << " Levels Skipped:     " << walk_levels_skipped << std::endl;
 }
 
 void mmu_t::flush_icache()
 {
-  for (size_t i = 0; i < ICACHE_ENTRIES; i++)
-    icache[i].tag = -1;
+  memset(icache_tag, -1, sizeof(icache_tag));
 }
 
 void mmu_t::flush_tlb()
 {
-  memset(tlb_insn_tag, -1, sizeof(tlb_insn_tag));
-  memset(tlb_load_tag, -1, sizeof(tlb_load_tag));
-  memset(tlb_store_tag, -1, sizeof(tlb_store_tag));
+  flush_tlb_entries();
+  flush_walk_cache(true, 0, true, 0);
+}
+
+void mmu_t::flush_tlb_vma(bool all_addrs, reg_t vaddr, bool all_asids, reg_t asid)
+{
+  flush_tlb_entries();
+  flush_walk_cache(all_addrs, vaddr, all_asids, asid);
+}
+
+void mmu_t::flush_walk_cache(bool all_addrs, reg_t vaddr, bool all_asids, reg_t asid)
+{
+  for (auto& entry : walk_cache) {
+    if (entry.tag == reg_t(-1))
+      continue;
+
+    if (!all_addrs && (vaddr >> entry.shift) != entry.tag)
+      continue;
+
+    // Only compare the ASID bits seen in cached satp values: rs2 bits beyond
+    // those can't tell entries apart, and satp may not implement them at all.
+    if (!all_asids) {
+      reg_t asid_field = proc->get_const_xlen() == 32 ? SATP32_ASID : SATP64_ASID;
+      if ((entry.satp & asid_field & walk_cache_asids) != (set_field(reg_t(0), asid_field, asid) & walk_cache_asids))
+        continue;
+    }
+
+    entry.tag = -1;
+  }
+}
+
+void mmu_t::flush_tlb_entries()
+{
+  memset(tlb_insn_tag, -1, tlb_sets * tlb_ways * sizeof(reg_t));
+  memset(tlb_load_tag, -1, tlb_sets * tlb_ways * sizeof(reg_t));
+  memset(tlb_store_tag, -1, tlb_sets * tlb_ways * sizeof(reg_t));
+
+  // with no translations left, context ids can start over
+  for (size_t i = 0; i < TLB_CONTEXTS; i++)
+    tlb_context_ids[i] = TLB_CONTEXT_INVALID;
+  tlb_context_victim = 0;
+  tlb_next_context = 0;
+  tlb_context = TLB_CONTEXT_INVALID;
 
   flush_icache();
 }
 
+void mmu_t::refresh_tlb_context()
+{
+  tlb_context_key_t key = {0, 0, 0, 0, 0, 0};
+  if (proc) {
+    key.prv = proc->state.prv;
+    if (key.prv != PRV_M) {
+      bool virt = proc->state.v;
+      key.virt = virt;
+      key.satp = proc->state.satp->readvirt(virt);
+      key.status = proc->state.sstatus->readvirt(false) & (MSTATUS_SUM | MSTATUS_MXR);
+      if (virt) {
+        key.hgatp = proc->state.hgatp;
+        key.vsstatus = proc->state.sstatus->readvirt(true) & (MSTATUS_SUM | MSTATUS_MXR);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < TLB_CONTEXTS; i++) {
+    if (tlb_context_ids[i] != TLB_CONTEXT_INVALID && tlb_context_keys[i] == key) {
+      tlb_context = tlb_context_ids[i];
+      return;
+    }
+  }
+
+  // An evicted context's id is never reused, so its stale translations can't
+  // be hit; once the ids run out, start over with an empty TLB.
+  if (tlb_next_context == TLB_CONTEXT_INVALID)
+    flush_tlb_entries();
+
+  size_t i = tlb_context_victim;
+  tlb_context_victim = (i + 1) % TLB_CONTEXTS;
+  tlb_context_keys[i] = key;
+  tlb_context_ids[i] = tlb_context = tlb_next_context;
+  tlb_next_context += reg_t(1) << TLB_CONTEXT_SHIFT;
+}
+
 static void throw_access_exception(bool virt, reg_t addr, access_type type)
 {
   switch (type) {
@@ -74,8 +217,40 @@ reg_t mmu_t::translate(reg_t addr, reg_t len, access_type type, uint32_t xlate_f
   return paddr;
 }
 
+char* mmu_t::atomic_host_addr(reg_t addr, reg_t len, reg_t& traced_paddr)
+{
+  traced_paddr = -1;
+
+  // Armed store triggers have to see the access before it happens, so leave
+  // it to store_slow_path, at the cost of atomicity against other harts.
+  if (check_triggers_store)
+    return NULL;
+
+  reg_t vpn = addr >> PGSHIFT;
+  if (tlb_store_tag[vpn & tlb_set_mask] == (vpn | tlb_context) ||
+      tlb_lookup_ways(tlb_store_tag, addr) != reg_t(-1))
+    return tlb_data[vpn & tlb_set_mask].host_offset + addr;
+
+  reg_t paddr = translate(addr, len, STORE, 0);
+  if (auto host_addr = sim->addr_to_mem(paddr)) {
+    // the update stays a host atomic even when a tracer watches the page
+    if (page_traced(paddr, STORE))
+      traced_paddr = paddr;
+    else
+      refill_tlb(addr, paddr, host_addr, STORE);
+    return host_addr;
+  }
+  return NULL;
+}
+
 tlb_entry_t mmu_t::fetch_slow_path(reg_t vaddr)
 {
+  if (tlb_lookup_ways(tlb_insn_tag, vaddr) != reg_t(-1)) {
+    count_tlb_hit(FETCH);
+    return tlb_data[(vaddr >> PGSHIFT) & tlb_set_mask];
+  }
+
+  count_tlb_miss(FETCH);
   reg_t paddr = translate(vaddr, sizeof(fetch_temp), FETCH, 0);
 
   if (auto host_addr = sim->addr_to_mem(paddr)) {
@@ -141,16 +316,26 @@ bool mmu_t::mmio_store(reg_t addr, size_t len, const uint8_t* bytes)
 
 void mmu_t::load_slow_path(reg_t addr, reg_t len, uint8_t* bytes, uint32_t xlate_flags)
 {
-  reg_t paddr = translate(addr, len, LOAD, xlate_flags);
-
-  if (auto host_addr = sim->addr_to_mem(paddr)) {
-    memcpy(bytes, host_addr, len);
-    if (tracer.interested_in_range(paddr, paddr + PGSIZE, LOAD))
-      tracer.trace(paddr, len, LOAD);
-    else if (xlate_flags == 0)
-      refill_tlb(addr, paddr, host_addr, LOAD);
-  } else if (!mmio_load(paddr, len, bytes)) {
-    throw trap_load_access_fault((proc) ? proc->state.v : false, addr, 0, 0);
+  reg_t tag = xlate_flags == 0 ? tlb_lookup_ways(tlb_load_tag, addr) : reg_t(-1);
+  if (tag != reg_t(-1)) {
+    count_tlb_hit(LOAD);
+    memcpy(bytes, tlb_data[(addr >> PGSHIFT) & tlb_set_mask].host_offset + addr, len);
+    if (!(tag & TLB_CHECK_TRIGGERS))
+      return;
+  } else {
+    if (xlate_flags == 0)
+      count_tlb_miss(LOAD);
+    reg_t paddr = translate(addr, len, LOAD, xlate_flags);
+
+    if (auto host_addr = sim->addr_to_mem(paddr)) {
+      memcpy(bytes, host_addr, len);
+      if (page_traced(paddr, LOAD))
+        tracer.trace(paddr, len, LOAD);
+      else if (xlate_flags == 0)
+        refill_tlb(addr, paddr, host_addr, LOAD);
+    } else if (!mmio_load(paddr, len, bytes)) {
+      throw trap_load_access_fault((proc) ? proc->state.v : false, addr, 0, 0);
+    }
   }
 
   if (!matched_trigger) {
@@ -163,18 +348,31 @@ void mmu_t::load_slow_path(reg_t addr, reg_t len, uint8_t* bytes, uint32_t xlate
 
 void mmu_t::store_slow_path(reg_t addr, reg_t len, const uint8_t* bytes, uint32_t xlate_flags)
 {
-  reg_t paddr = translate(addr, len, STORE, xlate_flags);
+  reg_t tag = xlate_flags == 0 ? tlb_lookup_ways(tlb_store_tag, addr) : reg_t(-1);
+  reg_t paddr = 0;
+  if (tag != reg_t(-1)) {
+    count_tlb_hit(STORE);
+  } else {
+    if (xlate_flags == 0)
+      count_tlb_miss(STORE);
+    paddr = translate(addr, len, STORE, xlate_flags);
+  }
 
-  if (!matched_trigger) {
+  if (!matched_trigger && (tag == reg_t(-1) || (tag & TLB_CHECK_TRIGGERS))) {
     reg_t data = reg_from_bytes(len, bytes);
     matched_trigger = trigger_exception(OPERATION_STORE, addr, data);
     if (matched_trigger)
       throw *matched_trigger;
   }
 
+  if (tag != reg_t(-1)) {
+    memcpy(tlb_data[(addr >> PGSHIFT) & tlb_set_mask].host_offset + addr, bytes, len);
+    return;
+  }
+
   if (auto host_addr = sim->addr_to_mem(paddr)) {
     memcpy(host_addr, bytes, len);
-    if (tracer.interested_in_range(paddr, paddr + PGSIZE, STORE))
+    if (page_traced(paddr, STORE))
       tracer.trace(paddr, len, STORE);
     else if (xlate_flags == 0)
       refill_tlb(addr, paddr, host_addr, STORE);
@@ -183,16 +381,58 @@ void mmu_t::store_slow_path(reg_t addr, reg_t len, const uint8_t* bytes, uint32_
   }
 }
 
+reg_t mmu_t::tlb_lookup_ways(const reg_t* tags, reg_t vaddr)
+{
+  reg_t vpn = vaddr >> PGSHIFT;
+  reg_t set = vpn & tlb_set_mask;
+  reg_t expected_tag = vpn | tlb_context;
+
+  for (size_t way = 1; way < tlb_ways; way++) {
+    if ((tags[way * tlb_sets + set] & ~TLB_CHECK_TRIGGERS) == expected_tag) {
+      tlb_move_to_front(set, way);
+      return tags[set];
+    }
+  }
+
+  return -1;
+}
+
+void mmu_t::tlb_move_to_front(size_t set, size_t way)
+{
+  for (size_t idx = way * tlb_sets + set; idx >= tlb_sets; idx -= tlb_sets) {
+    std::swap(tlb_data[idx], tlb_data[idx - tlb_sets]);
+    std::swap(tlb_insn_tag[idx], tlb_insn_tag[idx - tlb_sets]);
+    std::swap(tlb_load_tag[idx], tlb_load_tag[idx - tlb_sets]);
+    std::swap(tlb_store_tag[idx], tlb_store_tag[idx - tlb_sets]);
+  }
+}
+
 tlb_entry_t mmu_t::refill_tlb(reg_t vaddr, reg_t paddr, char* host_addr, access_type type)
 {
-  reg_t idx = (vaddr >> PGSHIFT) % TLB_ENTRIES;
-  reg_t expected_tag = vaddr >> PGSHIFT;
+  reg_t vpn = vaddr >> PGSHIFT;
+  reg_t idx = vpn & tlb_set_mask;
 
   tlb_entry_t entry = {host_addr - vaddr, paddr - vaddr};
 
   if (proc && get_field(proc->state.mstatus->read(), MSTATUS_MPRV))
     return entry;
 
+  reg_t expected_tag = vpn | current_tlb_context();
+
+  // Reuse the way that already maps this page, if any, so its permissions for
+  // other access types survive; otherwise replace the least recently used way.
+  size_t way = tlb_ways - 1;
+  for (size_t w = 0; w < tlb_ways; w++) {
+    size_t i = w * tlb_sets + idx;
+    if ((tlb_load_tag[i] & ~TLB_CHECK_TRIGGERS) == expected_tag ||
+        (tlb_store_tag[i] & ~TLB_CHECK_TRIGGERS) == expected_tag ||
+        (tlb_insn_tag[i] & ~TLB_CHECK_TRIGGERS) == expected_tag) {
+      way = w;
+      break;
+    }
+  }
+  tlb_move_to_front(idx, way);
+
   if ((tlb_load_tag[idx] & ~TLB_CHECK_TRIGGERS) != expected_tag)
     tlb_load_tag[idx] = -1;
   if ((tlb_store_tag[idx] & ~TLB_CHECK_TRIGGERS) != expected_tag)
@@ -207,7 +447,11 @@ tlb_entry_t mmu_t::refill_tlb(reg_t vaddr, reg_t paddr, char* host_addr, access_
 
   if (pmp_homogeneous(paddr & ~reg_t(PGSIZE - 1), PGSIZE)) {
     if (type == FETCH) tlb_insn_tag[idx] = expected_tag;
-    else if (type == STORE) tlb_store_tag[idx] = expected_tag;
+    else if (type == STORE) {
+      // stores to traced pages must keep taking the slow path
+      if (!page_traced(paddr, STORE))
+        tlb_store_tag[idx] = expected_tag;
+    }
     else tlb_load_tag[idx] = expected_tag;
   }
 
@@ -356,10 +600,29 @@ reg_t mmu_t::walk(reg_t addr, access_type type, reg_t mode, bool virt, bool hlvx
   if (masked_msbs != 0 && masked_msbs != mask)
     vm.levels = 0;
 
+  reg_t hgatp = virt ? proc->get_state()->hgatp : 0;
   reg_t base = vm.ptbase;
-  for (int i = vm.levels - 1; i >= 0; i--) {
+  int level = vm.levels - 1;
+  if (vm.levels > 0) {
+    walk_count++;
+    // resume from the deepest cached non-leaf PTE for this address, if any
+    for (int i = 1; i < vm.levels; i++) {
+      int shift = PGSHIFT + i * vm.idxbits;
+      auto& entry = walk_cache[walk_cache_index(addr >> shift, i)];
+      if (entry.tag == (addr >> shift) && entry.shift == shift &&
+          entry.satp == satp && entry.hgatp == hgatp && entry.virt == virt) {
+        base = entry.base;
+        level = i - 1;
+        walk_levels_skipped += vm.levels - 1 - level;
+        break;
+      }
+    }
+  }
+
+  for (int i = level; i >= 0; i--) {
     int ptshift = i * vm.idxbits;
     reg_t idx = (addr >> (PGSHIFT + ptshift)) & ((1 << vm.idxbits) - 1);
+    walk_levels_read++;
 
     // check that physical address of PTE is legal
     auto pte_paddr = s2xlate(addr, base + idx * vm.ptesize, LOAD, type, virt, false);
@@ -376,6 +639,12 @@ reg_t mmu_t::walk(reg_t addr, access_type type, reg_t mode, bool virt, bool hlvx
       if (pte & (PTE_D | PTE_A | PTE_U | PTE_N | PTE_PBMT))
         break;
       base = ppn << PGSHIFT;
+      if (i > 0) {
+        int shift = PGSHIFT + ptshift;
+        auto& entry = walk_cache[walk_cache_index(addr >> shift, i)];
+        entry = {addr >> shift, shift, virt, satp, hgatp, base};
+        walk_cache_asids |= satp;
+      }
     } else if ((pte & PTE_U) ? s_mode && (type == FETCH || !sum) : !s_mode) {
       break;
     } else if (!(pte & PTE_V) || (!(pte & PTE_R) && (pte & PTE_W))) {
@@ -28,10 +28,20 @@ struct insn_fetch_t
 
 struct icache_entry_t {
   reg_t tag;
-  struct icache_entry_t* next;
   insn_fetch_t data;
 };
 
+// A run of straight-line instructions within one page, decoded once and then
+// executed back-to-back by processor_t::step without a per-instruction lookup.
+// insns[i].tag holds the PC of the i-th instruction, and context is the TLB
+// context the block was decoded in.
+#define ICACHE_BLOCK_INSNS 8
+struct icache_block_t {
+  reg_t context;
+  size_t length;
+  icache_entry_t insns[ICACHE_BLOCK_INSNS];
+};
+
 struct tlb_entry_t {
   char* host_offset;
   reg_t target_offset;
@@ -103,13 +113,17 @@ public:
         else return misaligned_load(addr, sizeof(type##_t), xlate_flags); \
       } \
       reg_t vpn = addr >> PGSHIFT; \
+      reg_t idx = vpn & tlb_set_mask; \
+      reg_t tag = vpn | tlb_context; \
       size_t size = sizeof(type##_t); \
-      if ((xlate_flags) == 0 && likely(tlb_load_tag[vpn % TLB_ENTRIES] == vpn)) { \
+      if ((xlate_flags) == 0 && likely(tlb_load_tag[idx] == tag)) { \
+        count_tlb_hit(LOAD); \
         if (proc) READ_MEM(addr, size); \
-        return from_target(*(target_endian<type##_t>*)(tlb_data[vpn % TLB_ENTRIES].host_offset + addr)); \
+        return from_target(*(target_endian<type##_t>*)(tlb_data[idx].host_offset + addr)); \
       } \
-      if ((xlate_flags) == 0 && unlikely(tlb_load_tag[vpn % TLB_ENTRIES] == (vpn | TLB_CHECK_TRIGGERS))) { \
-        type##_t data = from_target(*(target_endian<type##_t>*)(tlb_data[vpn % TLB_ENTRIES].host_offset + addr)); \
+      if ((xlate_flags) == 0 && unlikely(tlb_load_tag[idx] == (tag | TLB_CHECK_TRIGGERS))) { \
+        count_tlb_hit(LOAD); \
+        type##_t data = from_target(*(target_endian<type##_t>*)(tlb_data[idx].host_offset + addr)); \
         if (!matched_trigger) { \
           matched_trigger = trigger_exception(OPERATION_LOAD, addr, data); \
           if (matched_trigger) \
@@ -163,19 +177,23 @@ public:
       if (unlikely(addr & (sizeof(type##_t)-1))) \
         return misaligned_store(addr, val, sizeof(type##_t), xlate_flags); \
       reg_t vpn = addr >> PGSHIFT; \
+      reg_t idx = vpn & tlb_set_mask; \
+      reg_t tag = vpn | tlb_context; \
       size_t size = sizeof(type##_t); \
-      if ((xlate_flags) == 0 && likely(tlb_store_tag[vpn % TLB_ENTRIES] == vpn)) { \
+      if ((xlate_flags) == 0 && likely(tlb_store_tag[idx] == tag)) { \
+        count_tlb_hit(STORE); \
         if (proc) WRITE_MEM(addr, val, size); \
-        *(target_endian<type##_t>*)(tlb_data[vpn % TLB_ENTRIES].host_offset + addr) = to_target(val); \
+        *(target_endian<type##_t>*)(tlb_data[idx].host_offset + addr) = to_target(val); \
       } \
-      else if ((xlate_flags) == 0 && unlikely(tlb_store_tag[vpn % TLB_ENTRIES] == (vpn | TLB_CHECK_TRIGGERS))) { \
+      else if ((xlate_flags) == 0 && unlikely(tlb_store_tag[idx] == (tag | TLB_CHECK_TRIGGERS))) { \
+        count_tlb_hit(STORE); \
         if (!matched_trigger) { \
           matched_trigger = trigger_exception(OPERATION_STORE, addr, val); \
           if (matched_trigger) \
             throw *matched_trigger; \
         } \
         if (proc) WRITE_MEM(addr, val, size); \
-        *(target_endian<type##_t>*)(tlb_data[vpn % TLB_ENTRIES].host_offset + addr) = to_target(val); \
+        *(target_endian<type##_t>*)(tlb_data[idx].host_offset + addr) = to_target(val); \
       } \
       else { \
         target_endian<type##_t> target_val = to_target(val); \
@@ -190,6 +208,11 @@ public:
     type##_t amo_##type(reg_t addr, op f) { \
       try { \
         auto lhs = load_##type(addr, true); \
+        if (unlikely(concurrent_harts)) { \
+          reg_t traced_paddr; \
+          if (auto host_addr = atomic_host_addr(addr, sizeof(type##_t), traced_paddr)) \
+            return atomic_update(addr, traced_paddr, (type##_t*)host_addr, lhs, f); \
+        } \
         store_##type(addr, f(lhs)); \
         return lhs; \
       } catch (trap_load_address_misaligned& t) { \
@@ -238,17 +261,105 @@ public:
   store_func(uint32, guest_store, RISCV_XLATE_VIRT)
   store_func(uint64, guest_store, RISCV_XLATE_VIRT)
 
+  // Host address of the len bytes at addr, for bulk transfers, if they lie
+  // in one little-endian page that hits in the TLB with nothing to check
+  // per access (triggers, tracers, commit log).  Otherwise NULL: the caller
+  // should use load_* or store_*, which refill the TLB or raise the fault.
+  char* direct_load_addr(reg_t addr, reg_t len)
+  {
+    return direct_addr(tlb_load_tag, addr, len, LOAD);
+  }
+
+  char* direct_store_addr(reg_t addr, reg_t len)
+  {
+    return direct_addr(tlb_store_tag, addr, len, STORE);
+  }
+
+  // Copy len bytes from guest memory at addr, for accelerators that move
+  // whole buffers.  Each page is copied at once if direct_load_addr allows;
+  // otherwise bytes go through load_uint8, which refills the TLB for the
+  // rest of the page or raises the fault.
+  void load_bytes(reg_t addr, reg_t len, uint8_t* bytes)
+  {
+    while (len) {
+      reg_t n = std::min(len, PGSIZE - (addr % PGSIZE));
+      if (char* host_addr = direct_load_addr(addr, n)) {
+        memcpy(bytes, host_addr, n);
+      } else {
+        n = 1;
+        *bytes = load_uint8(addr);
+      }
+      addr += n;
+      bytes += n;
+      len -= n;
+    }
+  }
+
+  void store_bytes(reg_t addr, reg_t len, const uint8_t* bytes)
+  {
+    while (len) {
+      reg_t n = std::min(len, PGSIZE - (addr % PGSIZE));
+      if (char* host_addr = direct_store_addr(addr, n)) {
+        memcpy(host_addr, bytes, n);
+      } else {
+        n = 1;
+        store_uint8(addr, *bytes);
+      }
+      addr += n;
+      bytes += n;
+      len -= n;
+    }
+  }
+
   // perform an atomic memory operation at an aligned address
   amo_func(uint32)
   amo_func(uint64)
 
+  // template for functions that complete a store-conditional whose
+  // reservation check has passed.  When harts run concurrently, another hart
+  // may have stored to the location since the load-reserved, so the store
+  // only happens if memory still holds the value the load-reserved returned.
+  // This is weaker than a real reservation, a known deviation: if other harts
+  // change the location and then change it back (ABA), the store-conditional
+  // still succeeds, where hardware would have lost the reservation.
+  #define store_conditional_func(type) \
+    bool store_conditional_##type(reg_t addr, type##_t val) { \
+      if (unlikely(concurrent_harts)) { \
+        reg_t traced_paddr; \
+        if (auto host_addr = atomic_host_addr(addr, sizeof(type##_t), traced_paddr)) { \
+          type##_t expected = target_bits(to_target((type##_t)load_reservation_value)); \
+          if (!__atomic_compare_exchange_n((type##_t*)host_addr, &expected, \
+                                           target_bits(to_target(val)), false, \
+                                           __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) \
+            return false; \
+          if (traced_paddr != reg_t(-1)) \
+            tracer.trace(traced_paddr, sizeof(type##_t), STORE); \
+          if (proc) WRITE_MEM(addr, val, sizeof(type##_t)); \
+          return true; \
+        } \
+      } \
+      store_##type(addr, val); \
+      return true; \
+    }
+
+  store_conditional_func(uint32)
+  store_conditional_func(uint64)
+
+  // Harts share memory with harts running on other host threads, so AMOs
+  // and store-conditionals must update memory with host atomics.
+  void set_concurrent_harts(bool enable)
+  {
+    concurrent_harts = enable;
+  }
+
   inline void yield_load_reservation()
   {
     load_reservation_address = (reg_t)-1;
   }
 
-  inline void acquire_load_reservation(reg_t vaddr)
+  inline void acquire_load_reservation(reg_t vaddr, reg_t value)
   {
+    load_reservation_value = value;
     reg_t paddr = translate(vaddr, 1, LOAD, 0);
     if (auto host_addr = sim->addr_to_mem(paddr))
       load_reservation_address = refill_tlb(vaddr, paddr, host_addr, LOAD).target_offset + vaddr;
@@ -317,7 +428,6 @@ public:
 
     insn_fetch_t fetch = {proc->decode_insn(insn), insn};
     entry->tag = addr;
-    entry->next = &icache[icache_index(addr + length)];
     entry->data = fetch;
 
     reg_t paddr = tlb_entry.target_offset + addr;;
@@ -328,12 +438,88 @@ public:
     return entry;
   }
 
-  inline icache_entry_t* access_icache(reg_t addr)
+  // Does this instruction possibly redirect control flow or change state
+  // that decoded blocks depend on (fence.i, CSRs, sfence.vma, custom
+  // instructions)?  If so, it must be the last instruction of its block.
+  static inline bool insn_ends_block(insn_bits_t insn)
+  {
+    switch (insn_length(insn)) {
+      case 2:
+        switch ((insn & 0x3) | ((insn >> 11) & 0x1c)) {
+          case 0x05: // c.jal/c.addiw
+          case 0x15: // c.j
+          case 0x19: // c.beqz
+          case 0x1d: // c.bnez
+            return true;
+          case 0x12: // c.jr/c.jalr/c.ebreak/c.mv/c.add
+            return ((insn >> 2) & 0x1f) == 0;
+          default:
+            return false;
+        }
+      case 4:
+        switch (insn & 0x7f) {
+          case 0x0b: // custom-0
+          case 0x0f: // misc-mem
+          case 0x2b: // custom-1
+          case 0x5b: // custom-2
+          case 0x63: // branch
+          case 0x67: // jalr
+          case 0x6f: // jal
+          case 0x73: // system
+          case 0x7b: // custom-3
+            return true;
+          default:
+            return false;
+        }
+      default:
+        return true;
+    }
+  }
+
+  icache_block_t* refill_icache_block(reg_t addr, size_t idx)
+  {
+    icache_block_t* block = &icache[idx];
+    block->context = current_tlb_context();
+    icache_tag[idx] = addr;
+    block->length = 1;
+
+    icache_entry_t* entry = refill_icache(addr, &block->insns[0]);
+    if (unlikely(entry->tag != addr)) {
+      // the tracer wants to see every fetch, so don't cache anything
+      icache_tag[idx] = -1;
+      return block;
+    }
+
+    // Only extend the block while the page is mapped by the ITLB, so that
+    // decoding ahead can neither fault nor bypass triggers or MMIO fetches.
+    reg_t vpn = addr >> PGSHIFT;
+    if (tlb_insn_tag[vpn & tlb_set_mask] != (vpn | block->context))
+      return block;
+
+    const char* host_offset = tlb_data[vpn & tlb_set_mask].host_offset;
+    reg_t page_end = (vpn + 1) << PGSHIFT;
+    reg_t pc = addr;
+    while (!insn_ends_block(entry->data.insn.bits()) && block->length < ICACHE_BLOCK_INSNS) {
+      pc += entry->data.insn.length();
+      if (pc >= page_end ||
+          pc + insn_length(from_le(*(const uint16_t*)(host_offset + pc))) > page_end)
+        break;
+
+      entry = refill_icache(pc, &block->insns[block->length]);
+      if (unlikely(entry->tag != pc))
+        break;
+      block->length++;
+    }
+
+    return block;
+  }
+
+  inline icache_block_t* access_icache(reg_t addr)
   {
-    icache_entry_t* entry = &icache[icache_index(addr)];
-    if (likely(entry->tag == addr))
-      return entry;
-    return refill_icache(addr, entry);
+    size_t idx = icache_index(addr);
+    if (likely(icache_tag[idx] == addr && icache[idx].context == tlb_context))
+      return &icache[idx];
+    return refill_icache_block(addr, idx);
   }
 
   inline insn_fetch_t load_insn(reg_t addr)
@@ -345,6 +531,28 @@ public:
   void flush_tlb();
   void flush_icache();
 
+  // sfence.vma: flush the TLB, and the cached non-leaf PTEs for the given
+  // virtual address and/or ASID
+  void flush_tlb_vma(bool all_addrs, reg_t vaddr, bool all_asids, reg_t asid);
+
+  // Translations are tagged with a context identifying the privilege mode,
+  // address-translation registers and mstatus.SUM/MXR they were made under,
+  // so that switching among them (e.g. on traps or satp writes) does not
+  // require a TLB flush.  Call this whenever any of them may have changed;
+  // the new context is looked up lazily on the next TLB miss.
+  void invalidate_tlb_context()
+  {
+    tlb_context = TLB_CONTEXT_INVALID;
+  }
+
+  // Use a TLB with the given number of sets (a power of 2) and ways.
+  void configure_tlb(size_t sets, size_t ways);
+  void print_tlb_stats();
+
+  // Count TLB hits and misses for print_tlb_stats.  This is off by default,
+  // so the fast paths don't update a counter on every access.
+  void set_tlb_stats(bool enable) { tlb_stats = enable; }
+
   void register_memtracer(memtracer_t*);
 
   int is_dirty_enabled()
@@ -389,28 +597,131 @@ public:
     return target_big_endian? target_endian<T>::to_be(n) : target_endian<T>::to_le(n);
   }
 
+  // the host representation of a target-endian value, for host atomics
+  template<typename T> static inline T target_bits(target_endian<T> n)
+  {
+    T bits;
+    memcpy(&bits, &n, sizeof(bits));
+    return bits;
+  }
+
+  template<typename T> inline T from_target_bits(T bits) const
+  {
+    target_endian<T> n;
+    memcpy((void*)&n, &bits, sizeof(bits));
+    return from_target(n);
+  }
+
 private:
   simif_t* sim;
   processor_t* proc;
   memtracer_list_t tracer;
   reg_t load_reservation_address;
+  reg_t load_reservation_value;
+  bool concurrent_harts;
   uint16_t fetch_temp;
 
   // implement an instruction cache for simulator performance
-  icache_entry_t icache[ICACHE_ENTRIES];
-
-  // implement a TLB for simulator performance
-  static const reg_t TLB_ENTRIES = 256;
+  reg_t icache_tag[ICACHE_ENTRIES];
+  icache_block_t icache[ICACHE_ENTRIES];
+
+  // implement a set-associative TLB for simulator performance.  Way w of set
+  // s lives at index w * tlb_sets + s, so the fast paths only ever probe the
+  // most-recently-used way 0; the other ways are searched on a miss.
+  static const size_t TLB_DEFAULT_SETS = 256;
+  static const size_t TLB_DEFAULT_WAYS = 4;
   // If a TLB tag has TLB_CHECK_TRIGGERS set, then the MMU must check for a
   // trigger match before completing an access.
   static const reg_t TLB_CHECK_TRIGGERS = reg_t(1) << 63;
-  tlb_entry_t tlb_data[TLB_ENTRIES];
-  reg_t tlb_insn_tag[TLB_ENTRIES];
-  reg_t tlb_load_tag[TLB_ENTRIES];
-  reg_t tlb_store_tag[TLB_ENTRIES];
+  // Tag bits above the VPN hold the id of the translation context.  Ids stop
+  // short of all-ones, so no lookup can match an empty (all-ones) tag.
+  static const int TLB_CONTEXT_SHIFT = 64 - PGSHIFT;
+  static const reg_t TLB_CONTEXT_INVALID = reg_t(0x7fe) << TLB_CONTEXT_SHIFT;
+  size_t tlb_sets;
+  size_t tlb_ways;
+  reg_t tlb_set_mask;
+  tlb_entry_t* tlb_data;
+  reg_t* tlb_insn_tag;
+  reg_t* tlb_load_tag;
+  reg_t* tlb_store_tag;
+  uint64_t tlb_hits[3];
+  uint64_t tlb_misses[3];
+  bool tlb_stats;
+
+  void count_tlb_hit(access_type type)
+  {
+    if (unlikely(tlb_stats))
+      tlb_hits[type]++;
+  }
+
+  void count_tlb_miss(access_type type)
+  {
+    if (unlikely(tlb_stats))
+      tlb_misses[type]++;
+  }
+
+  // recently used translation contexts and their ids
+  struct tlb_context_key_t {
+    reg_t prv;
+    reg_t virt;
+    reg_t satp;
+    reg_t hgatp;
+    reg_t status;
+    reg_t vsstatus;
+    bool operator==(const tlb_context_key_t& that) const
+    {
+      return prv == that.prv && virt == that.virt && satp == that.satp &&
+             hgatp == that.hgatp && status == that.status &&
+             vsstatus == that.vsstatus;
+    }
+  };
+  static const size_t TLB_CONTEXTS = 16;
+  tlb_context_key_t tlb_context_keys[TLB_CONTEXTS];
+  reg_t tlb_context_ids[TLB_CONTEXTS];
+  size_t tlb_context_victim;
+  reg_t tlb_next_context;
+  reg_t tlb_context;
+
+  void refresh_tlb_context();
+  void flush_tlb_entries();
+
+  // Cache of non-leaf PTEs, so that page table walks can start at the
+  // deepest level already known for an address.  An entry maps the VPN
+  // prefix tag (vaddr >> shift) under the given translation registers to the
+  // base of the next-level page table.
+  struct walk_cache_entry_t {
+    reg_t tag;
+    int shift;
+    bool virt;
+    reg_t satp;
+    reg_t hgatp;
+    reg_t base;
+  };
+  static const size_t WALK_CACHE_ENTRIES = 256;
+  walk_cache_entry_t walk_cache[WALK_CACHE_ENTRIES];
+  reg_t walk_cache_asids; // union of the cached satp values
+  uint64_t walk_count;
+  uint64_t walk_levels_read;
+  uint64_t walk_levels_skipped;
+
+  static size_t walk_cache_index(reg_t tag, int level)
+  {
+    return (tag * 4 + level) % WALK_CACHE_ENTRIES;
+  }
+  void flush_walk_cache(bool all_addrs, reg_t vaddr, bool all_asids, reg_t asid);
+  inline reg_t current_tlb_context()
+  {
+    if (unlikely(tlb_context == TLB_CONTEXT_INVALID))
+      refresh_tlb_context();
+    return tlb_context;
+  }
 
   // finish translation on a TLB miss and update the TLB
   tlb_entry_t refill_tlb(reg_t vaddr, reg_t paddr, char* host_addr, access_type type);
+  // search the other ways of vaddr's set; on a hit, make it way 0 and return
+  // its tag, else return -1
+  reg_t tlb_lookup_ways(const reg_t* tags, reg_t vaddr);
+  void tlb_move_to_front(size_t set, size_t way);
   const char* fill_from_mmio(reg_t vaddr, reg_t paddr);
 
   // perform a stage2 translation for a given guest address
@@ -419,6 +730,21 @@ private:
   // perform a page table walk for a given VA; set referenced/dirty bits
   reg_t walk(reg_t addr, access_type type, reg_t prv, bool virt, bool hlvx);
 
+  char* direct_addr(const reg_t* tags, reg_t addr, reg_t len, access_type type)
+  {
+#ifdef RISCV_ENABLE_COMMITLOG
+    return NULL;
+#else
+    reg_t vpn = addr >> PGSHIFT;
+    reg_t idx = vpn & tlb_set_mask;
+    if (target_big_endian || ((addr + len - 1) >> PGSHIFT) != vpn ||
+        tags[idx] != (vpn | tlb_context))
+      return NULL;
+    count_tlb_hit(type);
+    return tlb_data[idx].host_offset + addr;
+#endif
+  }
+
   // handle uncommon cases: TLB misses, page faults, MMIO
   tlb_entry_t fetch_slow_path(reg_t addr);
   void load_slow_path(reg_t addr, reg_t len, uint8_t* bytes, uint32_t xlate_flags);
@@ -428,19 +754,54 @@ private:
   bool mmio_ok(reg_t addr, access_type type);
   reg_t translate(reg_t addr, reg_t len, access_type type, uint32_t xlate_flags);
 
+  // whether a tracer watches any part of paddr's page, in which case the
+  // page must not be cached in the TLB for that access type
+  bool page_traced(reg_t paddr, access_type type)
+  {
+    reg_t base = paddr & ~reg_t(PGSIZE - 1);
+    return tracer.interested_in_range(base, base + PGSIZE, type);
+  }
+
+  // host address of a writable memory location, or NULL for MMIO or while
+  // store triggers are armed, which need the ordinary store path.
+  // traced_paddr is set to the physical address if a tracer watches stores
+  // to it, and to -1 otherwise; the caller reports the store once done.
+  char* atomic_host_addr(reg_t addr, reg_t len, reg_t& traced_paddr);
+
+  // atomically replace *host_addr, which currently holds lhs, by f(lhs)
+  template<typename T, typename op>
+  T atomic_update(reg_t addr, reg_t traced_paddr, T* host_addr, T lhs, op f)
+  {
+    T expected = target_bits(to_target(lhs));
+    T desired;
+    do {
+      lhs = from_target_bits(expected);
+      desired = f(lhs);
+    } while (!__atomic_compare_exchange_n(host_addr, &expected, target_bits(to_target(desired)),
+                                          true, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+    if (traced_paddr != reg_t(-1))
+      tracer.trace(traced_paddr, sizeof(T), STORE);
+    if (proc) WRITE_MEM(addr, desired, sizeof(T));
+    return lhs;
+  }
+
   // ITLB lookup
   inline tlb_entry_t translate_insn_addr(reg_t addr) {
     reg_t vpn = addr >> PGSHIFT;
-    if (likely(tlb_insn_tag[vpn % TLB_ENTRIES] == vpn))
-      return tlb_data[vpn % TLB_ENTRIES];
+    reg_t idx = vpn & tlb_set_mask;
+    if (likely(tlb_insn_tag[idx] == (vpn | tlb_context))) {
+      count_tlb_hit(FETCH);
+      return tlb_data[idx];
+    }
     tlb_entry_t result;
-    if (unlikely(tlb_insn_tag[vpn % TLB_ENTRIES] != (vpn | TLB_CHECK_TRIGGERS))) {
+    if (unlikely(tlb_insn_tag[idx] != (vpn | tlb_context | TLB_CHECK_TRIGGERS))) {
       result = fetch_slow_path(addr);
     } else {
-      result = tlb_data[vpn % TLB_ENTRIES];
+      count_tlb_hit(FETCH);
+      result = tlb_data[idx];
     }
-    if (unlikely(tlb_insn_tag[vpn % TLB_ENTRIES] == (vpn | TLB_CHECK_TRIGGERS))) {
-      target_endian<uint16_t>* ptr = (target_endian<uint16_t>*)(tlb_data[vpn % TLB_ENTRIES].host_offset + addr);
+    if (unlikely(tlb_insn_tag[idx] == (vpn | tlb_context | TLB_CHECK_TRIGGERS))) {
+      target_endian<uint16_t>* ptr = (target_endian<uint16_t>*)(tlb_data[idx].host_offset + addr);
       int match = proc->trigger_match(OPERATION_EXECUTE, addr, from_target(*ptr));
       if (match >= 0) {
         throw trigger_matched_t(match, OPERATION_EXECUTE, addr, from_target(*ptr));
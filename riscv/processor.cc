@@ -19,6 +19,7 @@
 #include <stdexcept>
 #include <string>
 #include <algorithm>
+#include <map>
 
 #undef STATE
 #define STATE state
@@ -27,7 +28,7 @@ processor_t::processor_t(const char* isa, const char* priv, const char* varch,
                          simif_t* sim, uint32_t id, bool halt_on_reset,
                          FILE* log_file, std::ostream& sout_)
   : debug(false), halt_request(HR_NONE), sim(sim), id(id), xlen(0),
-  histogram_enabled(false), log_commits_enabled(false),
+  histogram_enabled(false), log_commits_enabled(false), commit_trace(NULL),
   log_file(log_file), sout_(sout_.rdbuf()), halt_on_reset(halt_on_reset),
   extension_table(256, false), impl_table(256, false), last_pc(1), executions(1)
 {
@@ -462,6 +463,7 @@ void state_t::reset(processor_t* const proc, reg_t max_isa)
   fflags = 0;
   frm = 0;
   serialized = false;
+  returned_trap = 0;
 
 #ifdef RISCV_ENABLE_COMMITLOG
   log_reg_write.clear();
@@ -542,9 +544,10 @@ void processor_t::set_histogram(bool value)
 }
 
 #ifdef RISCV_ENABLE_COMMITLOG
-void processor_t::enable_log_commits()
+void processor_t::enable_log_commits(commit_trace_stream_t* trace)
 {
   log_commits_enabled = true;
+  commit_trace = trace;
 }
 #endif
 
@@ -552,6 +555,7 @@ void processor_t::reset()
 {
   xlen = max_xlen;
   state.reset(this, max_isa);
+  mmu->flush_tlb();
   state.dcsr.halt = halt_on_reset;
   halt_on_reset = false;
   VU.reset();
@@ -570,6 +574,164 @@ void processor_t::reset()
     sim->proc_reset(id);
 }
 
+static void put_state_bytes(std::vector<reg_t>& out, const void* src, size_t len)
+{
+  size_t pos = out.size();
+  out.resize(pos + (len + sizeof(reg_t) - 1) / sizeof(reg_t), 0);
+  if (len)
+    memcpy(&out[pos], src, len);
+}
+
+static reg_t get_state_word(const reg_t*& pos, const reg_t* end)
+{
+  if (pos == end)
+    throw std::runtime_error("truncated hart state");
+  return *pos++;
+}
+
+static void get_state_bytes(const reg_t*& pos, const reg_t* end, void* dst, size_t len)
+{
+  size_t words = (len + sizeof(reg_t) - 1) / sizeof(reg_t);
+  if (size_t(end - pos) < words)
+    throw std::runtime_error("truncated hart state");
+  if (len)
+    memcpy(dst, pos, len);
+  pos += words;
+}
+
+void processor_t::save_state(std::vector<reg_t>& out)
+{
+  out.push_back(isa_string.size());
+  put_state_bytes(out, isa_string.data(), isa_string.size());
+  out.push_back(VU.vlenb);
+
+  out.push_back(state.pc);
+  out.push_back(state.prv);
+  out.push_back(state.v);
+  out.push_back(state.debug_mode);
+  out.push_back(state.minstret);
+  for (size_t i = 0; i < NXPR; i++)
+    out.push_back(state.XPR[i]);
+  for (size_t i = 0; i < NFPR; i++)
+    put_state_bytes(out, &state.FPR[i], sizeof(freg_t));
+
+  // state that isn't (yet) held in csrmap
+  out.push_back(state.fflags);
+  out.push_back(state.frm);
+  out.push_back(state.mtval2);
+  out.push_back(state.mtinst);
+  out.push_back(state.hedeleg);
+  out.push_back(state.hideleg);
+  out.push_back(state.htval);
+  out.push_back(state.htinst);
+  out.push_back(state.hgatp);
+  out.push_back(state.dpc);
+  out.push_back(state.dscratch0);
+  out.push_back(state.dscratch1);
+  put_state_bytes(out, &state.dcsr, sizeof(state.dcsr));
+  out.push_back(state.tselect);
+  put_state_bytes(out, state.mcontrol, sizeof(state.mcontrol));
+  for (size_t i = 0; i < state.num_triggers; i++)
+    out.push_back(state.tdata2[i]);
+
+  // the raw state of each csrmap CSR that holds any, by address
+  std::map<reg_t, std::vector<reg_t>> csrs;
+  for (auto& csr : state.csrmap) {
+    auto raw = csr.second->save_raw();
+    if (!raw.empty())
+      csrs[csr.first] = raw;
+  }
+  out.push_back(csrs.size());
+  for (auto& csr : csrs) {
+    out.push_back(csr.first);
+    out.push_back(csr.second.size());
+    out.insert(out.end(), csr.second.begin(), csr.second.end());
+  }
+
+  out.push_back(VU.vstart);
+  out.push_back(VU.vxrm);
+  out.push_back(VU.vxsat);
+  out.push_back(VU.vl);
+  out.push_back(VU.vtype);
+  put_state_bytes(out, VU.reg_file, NVPR * VU.vlenb);
+}
+
+void processor_t::restore_state(const reg_t*& pos, const reg_t* end)
+{
+  std::string isa(get_state_word(pos, end), '\0');
+  get_state_bytes(pos, end, &isa[0], isa.size());
+  if (isa != isa_string)
+    throw std::runtime_error("hart " + std::to_string(id) + " was saved with ISA " + isa);
+  if (get_state_word(pos, end) != VU.vlenb)
+    throw std::runtime_error("hart " + std::to_string(id) + " was saved with a different VLEN");
+
+  reg_t pc = get_state_word(pos, end);
+  reg_t prv = get_state_word(pos, end);
+  bool v = get_state_word(pos, end);
+  state.debug_mode = get_state_word(pos, end);
+  reg_t minstret = get_state_word(pos, end);
+  for (size_t i = 0; i < NXPR; i++)
+    state.XPR.write(i, get_state_word(pos, end));
+  for (size_t i = 0; i < NFPR; i++) {
+    freg_t f;
+    get_state_bytes(pos, end, &f, sizeof(f));
+    state.FPR.write(i, f);
+  }
+
+  state.fflags = get_state_word(pos, end);
+  state.frm = get_state_word(pos, end);
+  state.mtval2 = get_state_word(pos, end);
+  state.mtinst = get_state_word(pos, end);
+  state.hedeleg = get_state_word(pos, end);
+  state.hideleg = get_state_word(pos, end);
+  state.htval = get_state_word(pos, end);
+  state.htinst = get_state_word(pos, end);
+  state.hgatp = get_state_word(pos, end);
+  state.dpc = get_state_word(pos, end);
+  state.dscratch0 = get_state_word(pos, end);
+  state.dscratch1 = get_state_word(pos, end);
+  get_state_bytes(pos, end, &state.dcsr, sizeof(state.dcsr));
+  state.tselect = get_state_word(pos, end);
+  get_state_bytes(pos, end, state.mcontrol, sizeof(state.mcontrol));
+  for (size_t i = 0; i < state.num_triggers; i++)
+    state.tdata2[i] = get_state_word(pos, end);
+  trigger_updated();
+
+  // Put the CSRs' raw state back as is: going through write() would
+  // legalize it again and apply side effects the saved state never had.
+  for (reg_t n = get_state_word(pos, end); n > 0; n--) {
+    reg_t addr = get_state_word(pos, end);
+    std::vector<reg_t> raw(get_state_word(pos, end));
+    for (auto& word : raw)
+      word = get_state_word(pos, end);
+    auto csr = state.csrmap.find(addr);
+    if (csr == state.csrmap.end() || csr->second->save_raw().size() != raw.size())
+      throw std::runtime_error("hart " + std::to_string(id) + " has no CSR " +
+                               csr_name(addr) + " like the saved one");
+    csr->second->restore_raw(raw);
+  }
+
+  reg_t vstart = get_state_word(pos, end);
+  VU.vxrm = get_state_word(pos, end);
+  VU.vxsat = get_state_word(pos, end);
+  reg_t vl = get_state_word(pos, end);
+  reg_t vtype = get_state_word(pos, end);
+  VU.vtype = ~vtype; // force set_vl to recompute the derived fields
+  VU.set_vl(1, 1, vl, vtype);
+  VU.vstart = vstart;
+  get_state_bytes(pos, end, VU.reg_file, NVPR * VU.vlenb);
+
+  state.pc = pc;
+  state.prv = prv;
+  state.v = v;
+  state.minstret = minstret;
+  state.serialized = false;
+  state.single_step = state.STEP_NONE;
+  mmu->yield_load_reservation();
+  mmu->flush_tlb();
+  mmu->flush_icache();
+}
+
 extension_t* processor_t::get_extension()
 {
   switch (custom_extensions.size()) {
@@ -636,10 +798,16 @@ void processor_t::set_mmu_capability(int cap)
 }
 
 void processor_t::take_interrupt(reg_t pending_interrupts)
+{
+  if (reg_t cause = interrupt_cause(pending_interrupts))
+    throw trap_t(cause);
+}
+
+reg_t processor_t::interrupt_cause(reg_t pending_interrupts)
 {
   // Do nothing if no pending interrupts
   if (!pending_interrupts) {
-    return;
+    return 0;
   }
 
   // M-ints have higher priority over HS-ints and VS-ints
@@ -686,8 +854,10 @@ void processor_t::take_interrupt(reg_t pending_interrupts)
     else
       abort();
 
-    throw trap_t(((reg_t)1 << (max_xlen-1)) | ctz(enabled_interrupts));
+    return ((reg_t)1 << (max_xlen-1)) | ctz(enabled_interrupts);
   }
+
+  return 0;
 }
 
 static int xlen_to_uxl(int xlen)
@@ -714,7 +884,7 @@ reg_t processor_t::legalize_privilege(reg_t prv)
 
 void processor_t::set_privilege(reg_t prv)
 {
-  mmu->flush_tlb();
+  mmu->invalidate_tlb_context();
   state.prv = legalize_privilege(prv);
 }
 
@@ -727,11 +897,11 @@ void processor_t::set_virt(bool virt)
 
   if (state.v != virt) {
     /*
-     * Ideally, we should flush TLB here but we don't need it because
-     * set_virt() is always used in conjucter with set_privilege() and
-     * set_privilege() will flush TLB unconditionally.
+     * Ideally, we should switch TLB contexts here but we don't need it
+     * because set_virt() is always used in conjucter with set_privilege()
+     * and set_privilege() will switch TLB contexts unconditionally.
      *
-     * The virtualized sstatus register also relies on this TLB flush,
+     * The virtualized sstatus register also relies on this context switch,
      * since changing V might change sstatus.MXR and sstatus.SUM.
      */
     state.v = virt;
@@ -863,6 +1033,49 @@ void processor_t::take_trap(trap_t& t, reg_t epc)
   }
 }
 
+void processor_t::take_step_trap(trap_t& t, reg_t epc)
+{
+  take_trap(t, epc);
+
+  if (unlikely(state.single_step == state.STEP_STEPPED)) {
+    state.single_step = state.STEP_NONE;
+    enter_debug_mode(DCSR_CAUSE_STEP);
+  }
+}
+
+void processor_t::take_returned_trap(reg_t epc)
+{
+  switch (state.returned_trap) {
+    case CAUSE_USER_ECALL: {
+      trap_user_ecall t;
+      take_step_trap(t, epc);
+      break;
+    }
+    case CAUSE_SUPERVISOR_ECALL: {
+      trap_supervisor_ecall t;
+      take_step_trap(t, epc);
+      break;
+    }
+    case CAUSE_VIRTUAL_SUPERVISOR_ECALL: {
+      trap_virtual_supervisor_ecall t;
+      take_step_trap(t, epc);
+      break;
+    }
+    case CAUSE_MACHINE_ECALL: {
+      trap_machine_ecall t;
+      take_step_trap(t, epc);
+      break;
+    }
+    case CAUSE_BREAKPOINT: {
+      trap_breakpoint t(epc);
+      take_step_trap(t, epc);
+      break;
+    }
+    default:
+      abort();
+  }
+}
+
 void processor_t::disasm(insn_t insn)
 {
   uint64_t bits = insn.bits() & ((1ULL << (8 * insn_length(insn.bits()))) - 1);
@@ -1000,7 +1213,7 @@ void processor_t::set_csr(int which, reg_t val)
       state.htinst = val;
       break;
     case CSR_HGATP: {
-      mmu->flush_tlb();
+      mmu->invalidate_tlb_context();
 
       reg_t mask;
       if (max_xlen == 32) {
@@ -1420,32 +1633,16 @@ reg_t illegal_instruction(processor_t* p, insn_t insn, reg_t pc)
 
 insn_func_t processor_t::decode_insn(insn_t insn)
 {
-  // look up opcode in hash table
-  size_t idx = insn.bits() % OPCODE_CACHE_SIZE;
-  insn_desc_t desc = opcode_cache[idx];
-
-  if (unlikely(insn.bits() != desc.match || !(xlen == 64 ? desc.rv64 : desc.rv32))) {
-    // fall back to linear search
-    int cnt = 0;
-    insn_desc_t* p = &instructions[0];
-    while ((insn.bits() & p->mask) != p->match || !(xlen == 64 ? p->rv64 : p->rv32))
-      p++, cnt++;
-    desc = *p;
-
-    if (p->mask != 0 && p > &instructions[0]) {
-      if (p->match != (p-1)->match && p->match != (p+1)->match) {
-        // move to front of opcode list to reduce miss penalty
-        while (--p >= &instructions[0])
-          *(p+1) = *p;
-        instructions[0] = desc;
-      }
-    }
+  // walk the decode tree down to a leaf
+  const decode_node_t* node = &decode_nodes[0];
+  while (node->width)
+    node = &decode_nodes[node->index + ((insn.bits() >> node->shift) & ((1U << node->width) - 1))];
 
-    opcode_cache[idx] = desc;
-    opcode_cache[idx].match = insn.bits();
-  }
+  const insn_desc_t* p = &decode_leaves[node->index];
+  while ((insn.bits() & p->mask) != p->match || !(xlen == 64 ? p->rv64 : p->rv32))
+    p++;
 
-  return xlen == 64 ? desc.rv64 : desc.rv32;
+  return xlen == 64 ? p->rv64 : p->rv32;
 }
 
 void processor_t::register_insn(insn_desc_t desc)
@@ -1464,8 +1661,65 @@ void processor_t::build_opcode_map()
   };
   std::sort(instructions.begin(), instructions.end(), cmp());
 
-  for (size_t i = 0; i < OPCODE_CACHE_SIZE; i++)
-    opcode_cache[i] = {0, 0, &illegal_instruction, &illegal_instruction};
+  std::vector<const insn_desc_t*> entries;
+  for (auto& insn : instructions)
+    entries.push_back(&insn);
+
+  decode_nodes.assign(1, decode_node_t());
+  decode_leaves.clear();
+  build_decode_node(0, entries, 0);
+}
+
+void processor_t::build_decode_node(size_t node,
+                                    const std::vector<const insn_desc_t*>& entries,
+                                    uint32_t decided)
+{
+  const size_t leaf_size = 4, max_width = 8;
+
+  // count how many entries fix each bit not yet switched on
+  size_t count[32] = {0};
+  int best = -1;
+  for (int b = 0; b < 32; b++) {
+    if (decided & (1U << b))
+      continue;
+    for (auto e : entries)
+      count[b] += (e->mask >> b) & 1;
+    if (count[b] && (best < 0 || count[b] > count[best]))
+      best = b;
+  }
+
+  if (entries.size() <= leaf_size || best < 0) {
+    decode_nodes[node] = {0, 0, uint32_t(decode_leaves.size())};
+    for (auto e : entries)
+      decode_leaves.push_back(*e);
+    return;
+  }
+
+  // Switch on the most-decided bit, widened to neighbouring bits that
+  // nearly as many entries fix.  Entries that don't fix a bit of the field
+  // are copied into every child they match, so keep that rare.
+  size_t threshold = std::max<size_t>(1, count[best] * 3 / 4);
+  int lo = best, hi = best;
+  while (size_t(hi - lo + 1) < max_width && hi < 31 &&
+         !(decided & (1U << (hi + 1))) && count[hi + 1] >= threshold)
+    hi++;
+  while (size_t(hi - lo + 1) < max_width && lo > 0 &&
+         !(decided & (1U << (lo - 1))) && count[lo - 1] >= threshold)
+    lo--;
+
+  size_t width = hi - lo + 1;
+  uint32_t field = ((1U << width) - 1) << lo;
+  size_t first = decode_nodes.size();
+  decode_nodes[node] = {uint8_t(lo), uint8_t(width), uint32_t(first)};
+  decode_nodes.resize(first + (size_t(1) << width));
+
+  for (size_t v = 0; v < (size_t(1) << width); v++) {
+    std::vector<const insn_desc_t*> child;
+    for (auto e : entries)
+      if (((e->match ^ (insn_bits_t(v) << lo)) & e->mask & field) == 0)
+        child.push_back(e);
+    build_decode_node(first + v, child, decided | field);
+  }
 }
 
 void processor_t::register_extension(extension_t* x)
@@ -16,6 +16,7 @@
 #include "csrs.h"
 
 class processor_t;
+class commit_trace_stream_t;
 class mmu_t;
 typedef reg_t (*insn_func_t)(processor_t*, insn_t, reg_t);
 class simif_t;
@@ -215,6 +216,7 @@ struct state_t
   uint32_t fflags;
   uint32_t frm;
   bool serialized; // whether timer CSRs are in a well-defined state
+  reg_t returned_trap; // cause of the trap an instruction raised via PC_TRAP
 
   // When true, execute a single instruction and then enter debug mode.  This
   // can only be set by executing dret.
@@ -291,8 +293,10 @@ public:
   void set_debug(bool value);
   void set_histogram(bool value);
 #ifdef RISCV_ENABLE_COMMITLOG
-  void enable_log_commits();
+  // Log commits as text to the log file, or to a binary trace if one's given.
+  void enable_log_commits(commit_trace_stream_t* trace = NULL);
   bool get_log_commits_enabled() const { return log_commits_enabled; }
+  commit_trace_stream_t* get_commit_trace() const { return commit_trace; }
 #endif
   void reset();
   void step(size_t n); // run for n cycles
@@ -302,6 +306,11 @@ public:
   reg_t get_csr(int which) { return get_csr(which, insn_t(0), false, true); }
   mmu_t* get_mmu() { return mmu; }
   state_t* get_state() { return &state; }
+  // Append this hart's architectural state to a checkpoint, or restore it
+  // from one.  restore_state throws std::runtime_error if the saved state
+  // doesn't fit this hart's configuration.
+  void save_state(std::vector<reg_t>& out);
+  void restore_state(const reg_t*& pos, const reg_t* end);
   unsigned get_xlen() { return xlen; }
   unsigned get_const_xlen() {
     // Any code that assumes a const xlen should use this method to
@@ -474,6 +483,7 @@ private:
   std::string isa_string;
   bool histogram_enabled;
   bool log_commits_enabled;
+  commit_trace_stream_t* commit_trace;
   FILE *log_file;
   std::ostream sout_; // needed for socket command interface -s, also used for -d and -l, but not for --log
   bool halt_on_reset;
@@ -485,12 +495,24 @@ private:
   std::vector<insn_desc_t> instructions;
   std::map<reg_t,uint64_t> pc_histogram;
 
-  static const size_t OPCODE_CACHE_SIZE = 8191;
-  insn_desc_t opcode_cache[OPCODE_CACHE_SIZE];
+  // Decode tree over the instructions, rebuilt by build_opcode_map.  Each
+  // inner node switches on a bit field of the instruction; each leaf holds
+  // the few instructions that can still match, in priority order, ending
+  // with the illegal-instruction catch-all.
+  struct decode_node_t {
+    uint8_t shift;  // field position,
+    uint8_t width;  // and width, or 0 for a leaf
+    uint32_t index; // first child in decode_nodes or entry in decode_leaves
+  };
+  std::vector<decode_node_t> decode_nodes;
+  std::vector<insn_desc_t> decode_leaves;
 
-  void take_pending_interrupt() { take_interrupt(state.mip->read() & state.mie->read()); }
+  reg_t pending_interrupt() { return interrupt_cause(state.mip->read() & state.mie->read()); }
+  reg_t interrupt_cause(reg_t mask); // cause of first enabled interrupt in mask, or 0
   void take_interrupt(reg_t mask); // take first enabled interrupt in mask
   void take_trap(trap_t& t, reg_t epc); // take an exception
+  void take_step_trap(trap_t& t, reg_t epc); // take an exception that ends step()
+  void take_returned_trap(reg_t epc); // take the trap an instruction returned
   void disasm(insn_t insn); // disassemble and print an instruction
   int paddr_bits();
 
@@ -506,6 +528,8 @@ private:
   void parse_priv_string(const char*);
   void parse_isa_string(const char*);
   void build_opcode_map();
+  void build_decode_node(size_t node, const std::vector<const insn_desc_t*>& entries,
+                         uint32_t decided);
   void register_base_instructions();
   insn_func_t decode_insn(insn_t insn);
 
@@ -520,7 +544,6 @@ public:
     public:
       processor_t* p;
       void *reg_file;
-      char reg_referenced[NVPR];
       int setvl_count;
       reg_t vlmax;
       reg_t vstart, vxrm, vxsat, vl, vtype, vlenb;
@@ -531,35 +554,85 @@ public:
       bool vill;
       bool vstart_alu;
 
+      // A register group as one array of elements, so that element n of the
+      // group is element n % elts_per_reg of register vReg + n / elts_per_reg.
+      // Loops set up a view per operand before they start, which makes each
+      // element access a plain array index.
+      class group_t {
+        public:
+          group_t(vectorUnit_t& vu, reg_t vReg)
+            : vu(vu), vReg(vReg), base((char*)vu.reg_file + vReg * (vu.VLEN >> 3)) {}
+
+          template<class T>
+            T& elt(reg_t n, bool is_write = false) const {
+              reg_t elts_per_reg = (vu.VLEN >> 3) / (sizeof(T));
+#ifdef WORDS_BIGENDIAN
+              // "V" spec 0.7.1 requires lower indices to map to lower significant
+              // bits when changing SEW, thus we need to index from the end on BE.
+              n ^= elts_per_reg - 1;
+#endif
+#ifdef RISCV_ENABLE_COMMITLOG
+              if (is_write)
+                vu.log_write(vReg + n / elts_per_reg);
+#endif
+              return ((T*)base)[n];
+            }
+
+        private:
+          vectorUnit_t& vu;
+          reg_t vReg;
+          char* base;
+      };
+
+      group_t group(reg_t vReg) { return group_t(*this, vReg); }
+
       // vector element for varies SEW
       template<class T>
         T& elt(reg_t vReg, reg_t n, bool is_write = false){
           assert(vsew != 0);
           assert((VLEN >> 3)/sizeof(T) > 0);
-          reg_t elts_per_reg = (VLEN >> 3) / (sizeof(T));
-          vReg += n / elts_per_reg;
-          n = n % elts_per_reg;
-#ifdef WORDS_BIGENDIAN
-          // "V" spec 0.7.1 requires lower indices to map to lower significant
-          // bits when changing SEW, thus we need to index from the end on BE.
-          n ^= elts_per_reg - 1;
-#endif
-          reg_referenced[vReg] = 1;
+          return group(vReg).elt<T>(n, is_write);
+        }
 
+      // The register group at vReg as an array of elements, for loops that
+      // access elements [start, end) directly rather than through elt.  Only
+      // meaningful on little-endian hosts.
+      template<class T>
+        T* elt_group(reg_t vReg, reg_t start, reg_t end, bool is_write = false){
+          assert(vsew != 0);
+          assert(start < end);
 #ifdef RISCV_ENABLE_COMMITLOG
+          reg_t elts_per_reg = (VLEN >> 3) / (sizeof(T));
           if (is_write)
-            p->get_state()->log_reg_write[((vReg) << 4) | 2] = {0, 0};
+            for (reg_t r = vReg + start / elts_per_reg; r <= vReg + (end - 1) / elts_per_reg; r++)
+              log_write(r);
 #endif
-
-          T *regStart = (T*)((char*)reg_file + vReg * (VLEN >> 3));
-          return regStart[n];
+          return (T*)((char*)reg_file + vReg * (VLEN >> 3));
         }
+
+#ifdef RISCV_ENABLE_COMMITLOG
+      // Registers written by the current instruction are collected here and
+      // entered in the commit log once it is done, rather than on every
+      // element write.
+      uint64_t written_regs;
+
+      void log_write(reg_t vReg) { written_regs |= uint64_t(1) << vReg; }
+
+      void log_writes() {
+        for (reg_t r = 0; written_regs; r++, written_regs >>= 1)
+          if (written_regs & 1)
+            p->get_state()->log_reg_write[(r << 4) | 2] = {0, 0};
+      }
+#endif
     public:
 
       void reset();
 
       vectorUnit_t(){
         reg_file = 0;
+#ifdef RISCV_ENABLE_COMMITLOG
+        written_regs = 0;
+#endif
       }
 
       ~vectorUnit_t(){
@@ -3,6 +3,7 @@
 #include "sim.h"
 #include "mmu.h"
 #include "dts.h"
+#include "commit_trace.h"
 #include "remote_bitbang.h"
 #include "byteorder.h"
 #include "platform.h"
@@ -15,6 +16,7 @@
 #include <cassert>
 #include <signal.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/wait.h>
 #include <sys/types.h>
 
@@ -64,6 +66,13 @@ sim_t::sim_t(const char* isa, const char* priv, const char* varch,
     histogram_enabled(false),
     log(false),
     remote_bitbang(NULL),
+    nthreads(1),
+    quantum_gen(0),
+    quantum_steps(0),
+    quantum_pending(0),
+    hart_threads_exit(false),
+    quanta_since_host(0),
+    checkpoint_insns(0),
     debug_module(this, dm_config)
 {
   signal(SIGINT, &handle_signal);
@@ -165,6 +174,14 @@ sim_t::sim_t(const char* isa, const char* priv, const char* varch,
 
 sim_t::~sim_t()
 {
+  {
+    std::lock_guard<std::mutex> lock(quantum_lock);
+    hart_threads_exit = true;
+  }
+  quantum_start.notify_all();
+  for (auto& t : hart_threads)
+    t.join();
+
   for (size_t i = 0; i < procs.size(); i++)
     delete procs[i];
   delete debug_mmu;
@@ -180,12 +197,22 @@ void sim_t::main()
   if (!debug && log)
     set_procs_debug(true);
 
+  if (!restore_path.empty())
+    restore_checkpoint(restore_path);
+
   while (!done())
   {
     if (debug || ctrlc_pressed)
       interactive();
     else
       step(INTERLEAVE);
+    // only checkpoint between rounds, when no hart is part-way through
+    // its quantum
+    if (!checkpoint_path.empty() && current_step == 0 && current_proc == 0 &&
+        procs[0]->get_state()->minstret >= checkpoint_insns) {
+      save_checkpoint(checkpoint_path);
+      checkpoint_path.clear();
+    }
     if (remote_bitbang) {
       remote_bitbang->tick();
     }
@@ -201,6 +228,11 @@ int sim_t::run()
 
 void sim_t::step(size_t n)
 {
+  if (nthreads > 1) {
+    step_parallel(n);
+    return;
+  }
+
   for (size_t i = 0, steps = 0; i < n; i += steps)
   {
     steps = std::min(n - i, INTERLEAVE - current_step);
@@ -216,11 +248,250 @@ void sim_t::step(size_t n)
         clint->increment(INTERLEAVE / INSNS_PER_RTC_TICK);
       }
 
-      host->switch_to();
+      if (host_switch_due())
+        host->switch_to();
+    }
+  }
+}
+
+void sim_t::step_parallel(size_t n)
+{
+  for (size_t i = 0, steps = 0; i < n; i += steps)
+  {
+    steps = std::min(n - i, INTERLEAVE - current_step);
+
+    {
+      std::lock_guard<std::mutex> lock(quantum_lock);
+      quantum_steps = steps;
+      quantum_pending = nthreads - 1;
+      quantum_gen++;
+    }
+    quantum_start.notify_all();
+
+    step_hart_group(0, steps);
+
+    {
+      std::unique_lock<std::mutex> lock(quantum_lock);
+      quantum_done.wait(lock, [this] { return quantum_pending == 0; });
+    }
+
+    current_step += steps;
+    if (current_step == INTERLEAVE)
+    {
+      current_step = 0;
+      for (auto p : procs)
+        p->get_mmu()->yield_load_reservation();
+      clint->increment(INTERLEAVE / INSNS_PER_RTC_TICK);
+
+      if (host_switch_due())
+        host->switch_to();
+    }
+  }
+}
+
+bool sim_t::host_switch_due()
+{
+  if (!htif_watch.active() || htif_watch.written.exchange(false) ||
+      ++quanta_since_host == HTIF_POLL_QUANTA) {
+    quanta_since_host = 0;
+    return true;
+  }
+  return false;
+}
+
+void sim_t::htif_watch_t::watch(reg_t tohost, reg_t fromhost)
+{
+  this->tohost = tohost;
+  this->fromhost = fromhost;
+}
+
+static bool overlaps_dword(uint64_t begin, uint64_t end, reg_t addr)
+{
+  return addr && begin < addr + 8 && addr < end;
+}
+
+bool sim_t::htif_watch_t::interested_in_range(uint64_t begin, uint64_t end, access_type type)
+{
+  return type == STORE &&
+         (overlaps_dword(begin, end, tohost) || overlaps_dword(begin, end, fromhost));
+}
+
+void sim_t::htif_watch_t::trace(uint64_t addr, size_t bytes, access_type type)
+{
+  if (type == STORE &&
+      (overlaps_dword(addr, addr + bytes, tohost) || overlaps_dword(addr, addr + bytes, fromhost)))
+    written = true;
+}
+
+void sim_t::step_hart_group(size_t group, size_t n)
+{
+  for (size_t i = group; i < procs.size(); i += nthreads)
+    procs[i]->step(n);
+}
+
+void sim_t::hart_thread_main(size_t group)
+{
+  size_t gen = 0;
+  while (true) {
+    size_t steps;
+    {
+      std::unique_lock<std::mutex> lock(quantum_lock);
+      quantum_start.wait(lock, [&] { return hart_threads_exit || quantum_gen != gen; });
+      if (hart_threads_exit)
+        return;
+      gen = quantum_gen;
+      steps = quantum_steps;
+    }
+
+    step_hart_group(group, steps);
+
+    bool last;
+    {
+      std::lock_guard<std::mutex> lock(quantum_lock);
+      last = --quantum_pending == 0;
     }
+    if (last)
+      quantum_done.notify_one();
+  }
+}
+
+void sim_t::set_threads(size_t n)
+{
+  nthreads = std::max(std::min(n, procs.size()), size_t(1));
+  for (auto p : procs)
+    p->get_mmu()->set_concurrent_harts(nthreads > 1);
+  for (size_t i = 1; i < nthreads; i++)
+    hart_threads.emplace_back(&sim_t::hart_thread_main, this, i);
+}
+
+// A checkpoint file holds, in host byte order: a header; one
+// checkpoint_mem_t per memory; the hart and CLINT state as reg_t words; and
+// then each memory image at an aligned offset, so that its all-zero pages
+// can be left as file holes.  Bump CHECKPOINT_VERSION whenever any of it
+// changes.
+struct checkpoint_header_t {
+  char magic[8];
+  uint32_t version;
+  uint32_t nprocs;
+  uint64_t nmems;
+  uint64_t state_words;
+};
+
+struct checkpoint_mem_t {
+  uint64_t base;
+  uint64_t size;
+  uint64_t offset;
+};
+
+static const char CHECKPOINT_MAGIC[8] = {'s', 'p', 'i', 'k', 'e', 'c', 'k', 'p'};
+static const uint32_t CHECKPOINT_VERSION = 2;
+static const uint64_t CHECKPOINT_ALIGN = 1 << 16; // >= any host page size
+
+static uint64_t checkpoint_align(uint64_t x)
+{
+  return (x + CHECKPOINT_ALIGN - 1) & ~(CHECKPOINT_ALIGN - 1);
+}
+
+void sim_t::save_checkpoint(const std::string& path)
+{
+  std::vector<reg_t> state;
+  for (auto p : procs)
+    p->save_state(state);
+  clint->save_state(state);
+
+  checkpoint_header_t header;
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+  header.version = CHECKPOINT_VERSION;
+  header.nprocs = procs.size();
+  header.nmems = mems.size();
+  header.state_words = state.size();
+
+  std::vector<checkpoint_mem_t> mem_table;
+  uint64_t offset = checkpoint_align(sizeof(header) +
+    mems.size() * sizeof(checkpoint_mem_t) + state.size() * sizeof(reg_t));
+  for (auto& m : mems) {
+    mem_table.push_back({m.first, m.second->size(), offset});
+    offset = checkpoint_align(offset + m.second->size());
+  }
+
+  std::string head((const char*)&header, sizeof(header));
+  head.append((const char*)mem_table.data(), mem_table.size() * sizeof(checkpoint_mem_t));
+  head.append((const char*)state.data(), state.size() * sizeof(reg_t));
+
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  // keep the first failure; later calls, close() included, may change errno
+  std::string error;
+  if (fd < 0) {
+    error = strerror(errno);
+  } else {
+    ssize_t n = pwrite(fd, head.data(), head.size(), 0);
+    if (n != (ssize_t)head.size())
+      error = n < 0 ? strerror(errno) : "short write";
+    for (size_t i = 0; error.empty() && i < mems.size(); i++)
+      if (!mems[i].second->save(fd, mem_table[i].offset))
+        error = errno ? strerror(errno) : "short write";
+    // extend the file over the trailing all-zero pages
+    if (error.empty() && ftruncate(fd, offset) != 0)
+      error = strerror(errno);
+    if (close(fd) != 0 && error.empty())
+      error = strerror(errno);
+  }
+  if (!error.empty()) {
+    std::cerr << "can't write checkpoint " << path << ": " << error << std::endl;
+    exit(1);
   }
 }
 
+void sim_t::restore_checkpoint(const std::string& path)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "can't open checkpoint " << path << ": " << strerror(errno) << std::endl;
+    exit(1);
+  }
+
+  try {
+    checkpoint_header_t header;
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+        memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0)
+      throw std::runtime_error("not a checkpoint file");
+    if (header.version != CHECKPOINT_VERSION)
+      throw std::runtime_error("unsupported version " + std::to_string(header.version));
+    if (header.nprocs != procs.size() || header.nmems != mems.size())
+      throw std::runtime_error("saved with a different number of harts or memories");
+
+    std::vector<checkpoint_mem_t> mem_table(header.nmems);
+    std::vector<reg_t> state(header.state_words);
+    ssize_t table_size = mem_table.size() * sizeof(checkpoint_mem_t);
+    ssize_t state_size = state.size() * sizeof(reg_t);
+    if (pread(fd, mem_table.data(), table_size, sizeof(header)) != table_size ||
+        pread(fd, state.data(), state_size, sizeof(header) + table_size) != state_size)
+      throw std::runtime_error("truncated file");
+
+    for (size_t i = 0; i < mems.size(); i++) {
+      if (mem_table[i].base != mems[i].first || mem_table[i].size != mems[i].second->size())
+        throw std::runtime_error("saved with a different memory layout");
+      if (!mems[i].second->restore(fd, mem_table[i].offset))
+        throw std::runtime_error(std::string("can't read memory image: ") +
+                                 (errno ? strerror(errno) : "truncated file"));
+    }
+
+    const reg_t* pos = state.data();
+    const reg_t* end = pos + state.size();
+    for (auto p : procs)
+      p->restore_state(pos, end);
+    clint->restore_state(pos, end);
+    if (pos != end)
+      throw std::runtime_error("trailing state");
+  } catch (std::runtime_error& e) {
+    std::cerr << "can't restore checkpoint " << path << ": " << e.what() << std::endl;
+    exit(1);
+  }
+
+  close(fd);
+  debug_mmu->flush_tlb();
+}
+
 void sim_t::set_debug(bool value)
 {
   debug = value;
@@ -234,7 +505,8 @@ void sim_t::set_histogram(bool value)
   }
 }
 
-void sim_t::configure_log(bool enable_log, bool enable_commitlog)
+void sim_t::configure_log(bool enable_log, bool enable_commitlog,
+                          const char* commit_trace_path)
 {
   log = enable_log;
 
@@ -248,8 +520,10 @@ void sim_t::configure_log(bool enable_log, bool enable_commitlog)
         stderr);
   abort();
 #else
+  if (commit_trace_path)
+    commit_trace.reset(new commit_trace_t(commit_trace_path));
   for (processor_t *proc : procs) {
-    proc->enable_log_commits();
+    proc->enable_log_commits(commit_trace ? commit_trace->stream(proc->get_id()) : NULL);
   }
 #endif
 }
@@ -269,6 +543,10 @@ bool sim_t::mmio_load(reg_t addr, size_t len, uint8_t* bytes)
 {
   if (addr + len < addr || !paddr_ok(addr + len - 1))
     return false;
+  if (nthreads > 1) {
+    std::lock_guard<std::mutex> lock(bus_lock);
+    return bus.load(addr, len, bytes);
+  }
   return bus.load(addr, len, bytes);
 }
 
@@ -276,6 +554,10 @@ bool sim_t::mmio_store(reg_t addr, size_t len, const uint8_t* bytes)
 {
   if (addr + len < addr || !paddr_ok(addr + len - 1))
     return false;
+  if (nthreads > 1) {
+    std::lock_guard<std::mutex> lock(bus_lock);
+    return bus.store(addr, len, bytes);
+  }
   return bus.store(addr, len, bytes);
 }
 
@@ -381,6 +663,12 @@ void sim_t::reset()
 {
   if (dtb_enabled)
     set_rom();
+
+  if (get_tohost_addr() && !htif_watch.active()) {
+    htif_watch.watch(get_tohost_addr(), get_fromhost_addr());
+    for (auto p : procs)
+      p->get_mmu()->register_memtracer(&htif_watch);
+  }
 }
 
 void sim_t::idle()
@@ -388,19 +676,80 @@ void sim_t::idle()
   target.switch_to();
 }
 
+// Chunks are copied a page at a time straight out of (or into) the backing
+// mem_t; only device regions are still accessed 8 bytes at a time
 void sim_t::read_chunk(addr_t taddr, size_t len, void* dst)
 {
-  assert(len == 8);
-  auto data = debug_mmu->to_target(debug_mmu->load_uint64(taddr));
-  memcpy(dst, &data, sizeof data);
+  assert(len % 8 == 0 && len <= chunk_max_size());
+  while (len > 0) {
+    size_t n;
+    if (char* host_addr = addr_to_mem(taddr)) {
+      n = std::min(len, size_t(PGSIZE - taddr % PGSIZE));
+      memcpy(dst, host_addr, n);
+    } else {
+      n = 8;
+      auto data = debug_mmu->to_target(debug_mmu->load_uint64(taddr));
+      memcpy(dst, &data, sizeof data);
+    }
+    taddr += n;
+    dst = (char*)dst + n;
+    len -= n;
+  }
 }
 
 void sim_t::write_chunk(addr_t taddr, size_t len, const void* src)
 {
-  assert(len == 8);
-  target_endian<uint64_t> data;
-  memcpy(&data, src, sizeof data);
-  debug_mmu->store_uint64(taddr, debug_mmu->from_target(data));
+  assert(len % 8 == 0 && len <= chunk_max_size());
+  while (len > 0) {
+    size_t n;
+    if (char* host_addr = addr_to_mem(taddr)) {
+      n = std::min(len, size_t(PGSIZE - taddr % PGSIZE));
+      memcpy(host_addr, src, n);
+    } else {
+      n = 8;
+      target_endian<uint64_t> data;
+      memcpy(&data, src, sizeof data);
+      debug_mmu->store_uint64(taddr, debug_mmu->from_target(data));
+    }
+    taddr += n;
+    src = (const char*)src + n;
+    len -= n;
+  }
+}
+
+// Pages that already read as zero are left alone, so clearing a large .bss
+// doesn't commit host memory for it
+void sim_t::clear_chunk(addr_t taddr, size_t len)
+{
+  static const char zeros[PGSIZE] = {};
+
+  while (len > 0) {
+    size_t n = std::min(len, size_t(PGSIZE - taddr % PGSIZE));
+    if (char* host_addr = addr_to_mem(taddr)) {
+      if (memcmp(host_addr, zeros, n) != 0)
+        memset(host_addr, 0, n);
+    } else {
+      n = std::min(len, size_t(8));
+      write_chunk(taddr, 8, zeros);
+    }
+    taddr += n;
+    len -= n;
+  }
+}
+
+bool sim_t::load_file(addr_t taddr, size_t len, int fd, off_t offset)
+{
+  if (!paddr_ok(taddr))
+    return false;
+  auto desc = bus.find_device(taddr);
+  auto mem = dynamic_cast<mem_t*>(desc.second);
+  return mem && mem->load_file(taddr - desc.first, len, fd, offset);
+}
+
+void* sim_t::host_addr(addr_t taddr, size_t& len)
+{
+  len = std::min(len, size_t(PGSIZE - taddr % PGSIZE));
+  return addr_to_mem(taddr);
 }
 
 void sim_t::set_target_endianness(memif_endianness_t endianness)
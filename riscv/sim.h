@@ -16,16 +16,22 @@
 #include "log_file.h"
 #include "processor.h"
 #include "simif.h"
+#include "memtracer.h"
 
 #include <fesvr/htif.h>
 #include <fesvr/context.h>
 #include <vector>
 #include <string>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <sys/types.h>
 
 class mmu_t;
 class remote_bitbang_t;
+class commit_trace_t;
 
 // this class encapsulates the processors and memory in a RISC-V machine.
 class sim_t : public htif_t, public simif_t
@@ -50,13 +56,30 @@ public:
   void set_debug(bool value);
   void set_histogram(bool value);
 
+  // Run the harts on up to nthreads host threads.  Each hart executes a
+  // quantum of INTERLEAVE instructions concurrently with the others; devices,
+  // HTIF and the CLINT are serviced between quanta.
+  void set_threads(size_t nthreads);
+
+  // Save a checkpoint of the harts, memories and CLINT to path once hart 0
+  // has retired insns instructions, then keep running.  A checkpoint given
+  // to set_restore is loaded in place of the initial state instead.
+  void set_checkpoint(reg_t insns, const char* path) {
+    checkpoint_insns = insns;
+    checkpoint_path = path;
+  }
+  void set_restore(const char* path) { restore_path = path; }
+
   // Configure logging
   //
   // If enable_log is true, an instruction trace will be generated. If
   // enable_commitlog is true, so will the commit results (if this
   // build was configured without support for commit logging, the
-  // function will print an error message and abort).
-  void configure_log(bool enable_log, bool enable_commitlog);
+  // function will print an error message and abort).  If commit_trace_path
+  // is given, the commit results are written there as a binary trace rather
+  // than as text to the log file.
+  void configure_log(bool enable_log, bool enable_commitlog,
+                     const char* commit_trace_path = NULL);
 
   void set_procs_debug(bool value);
   void set_remote_bitbang(remote_bitbang_t* remote_bitbang) {
@@ -86,6 +109,7 @@ private:
   std::unique_ptr<clint_t> clint;
   bus_t bus;
   log_file_t log_file;
+  std::unique_ptr<commit_trace_t> commit_trace;
 
   FILE *cmd_file; // pointer to debug command input file
 
@@ -115,6 +139,47 @@ private:
   char* addr_to_mem(reg_t addr);
   bool mmio_load(reg_t addr, size_t len, uint8_t* bytes);
   bool mmio_store(reg_t addr, size_t len, const uint8_t* bytes);
+  std::mutex bus_lock; // serializes device accesses from concurrent harts
+
+  // host threads for running harts concurrently
+  void step_parallel(size_t n);
+  void step_hart_group(size_t group, size_t n);
+  void hart_thread_main(size_t group);
+  size_t nthreads;
+  std::vector<std::thread> hart_threads;
+  std::mutex quantum_lock;
+  std::condition_variable quantum_start;
+  std::condition_variable quantum_done;
+  size_t quantum_gen;
+  size_t quantum_steps;
+  size_t quantum_pending;
+  bool hart_threads_exit;
+
+  // Stores to tohost and fromhost are traced rather than cached in the TLB,
+  // so the harts only yield to the HTIF host once one of them has been
+  // written, or every HTIF_POLL_QUANTA quanta so that devices keep ticking.
+  class htif_watch_t : public memtracer_t {
+   public:
+    htif_watch_t() : written(false), tohost(0), fromhost(0) {}
+    void watch(reg_t tohost, reg_t fromhost);
+    bool active() { return tohost != 0; }
+    bool interested_in_range(uint64_t begin, uint64_t end, access_type type);
+    void trace(uint64_t addr, size_t bytes, access_type type);
+    std::atomic<bool> written;
+   private:
+    reg_t tohost, fromhost;
+  } htif_watch;
+  static const size_t HTIF_POLL_QUANTA = 200;
+  size_t quanta_since_host;
+  bool host_switch_due();
+
+  // checkpointing
+  void save_checkpoint(const std::string& path);
+  void restore_checkpoint(const std::string& path);
+  reg_t checkpoint_insns;
+  std::string checkpoint_path;
+  std::string restore_path;
+
   void make_dtb();
   void set_rom();
 
@@ -160,8 +225,11 @@ private:
   void idle();
   void read_chunk(addr_t taddr, size_t len, void* dst);
   void write_chunk(addr_t taddr, size_t len, const void* src);
+  void clear_chunk(addr_t taddr, size_t len);
+  bool load_file(addr_t taddr, size_t len, int fd, off_t offset);
+  void* host_addr(addr_t taddr, size_t& len);
   size_t chunk_align() { return 8; }
-  size_t chunk_max_size() { return 8; }
+  size_t chunk_max_size() { return PGSIZE; }
   void set_target_endianness(memif_endianness_t endianness);
   memif_endianness_t get_target_endianness() const;
 
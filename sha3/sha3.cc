@@ -5,72 +5,88 @@
 #include "config.h"
 
 constexpr uint64_t sha3_t::keccakf_rndc[24];
-constexpr int sha3_t::keccakf_rotc[24];
-constexpr int sha3_t::keccakf_piln[24];
 
-void printState(uint64_t st[25])
-{
-  int i,j;
-  for(i = 0; i<5; i++){
-     for(j = 0; j<5; j++){
-       printf("%016llx ", st[i+j*5]);
-     }
-     printf("\n");
-  }
-  printf("\n");
-}
-
-// update the state with given number of rounds
+// update the state with given number of rounds.  The rounds are written
+// out lane by lane, on a copy of the state the compiler can keep in
+// registers.
 void sha3_t::keccakf(uint64_t st[25], int rounds)
 {
-  int i, j, round_num;
-  uint64_t t, bc[5];
+  uint64_t a[25], b[25], c[5], d[5];
+  memcpy(a, st, sizeof(a));
 
-  //printf("Starting\n");
-  //printState(st);
-  for (round_num = 0; round_num < rounds; round_num++) 
+  for (int round_num = 0; round_num < rounds; round_num++)
   {
     // Theta
-    for (i = 0; i < 5; i++) 
-      bc[i] = st[i] ^ st[i + 5] ^ st[i + 10] ^ st[i + 15] ^ st[i + 20];
-    
-    for (i = 0; i < 5; i++) 
-    {
-      t = bc[(i + 4) % 5] ^ ROTL64(bc[(i + 1) % 5], 1);
-      for (j = 0; j < 25; j += 5)
-  st[j + i] ^= t;
-      }
+    c[0] = a[0] ^ a[5] ^ a[10] ^ a[15] ^ a[20];
+    c[1] = a[1] ^ a[6] ^ a[11] ^ a[16] ^ a[21];
+    c[2] = a[2] ^ a[7] ^ a[12] ^ a[17] ^ a[22];
+    c[3] = a[3] ^ a[8] ^ a[13] ^ a[18] ^ a[23];
+    c[4] = a[4] ^ a[9] ^ a[14] ^ a[19] ^ a[24];
+    d[0] = c[4] ^ ROTL64(c[1], 1);
+    d[1] = c[0] ^ ROTL64(c[2], 1);
+    d[2] = c[1] ^ ROTL64(c[3], 1);
+    d[3] = c[2] ^ ROTL64(c[4], 1);
+    d[4] = c[3] ^ ROTL64(c[0], 1);
 
-    //printf("After Theta:\n");
-    //printState(st);
     // Rho Pi
-    t = st[1];
-    for (i = 0; i < 24; i++) 
-    {
-      j = sha3_t::keccakf_piln[i];
-      bc[0] = st[j];
-      st[j] = ROTL64(t, sha3_t::keccakf_rotc[i]);
-      t = bc[0];
-    }
-    //printf("After RhoPi:\n");
-    //printState(st);
+    b[0] = a[0] ^ d[0];
+    b[10] = ROTL64(a[1] ^ d[1], 1);
+    b[20] = ROTL64(a[2] ^ d[2], 62);
+    b[5] = ROTL64(a[3] ^ d[3], 28);
+    b[15] = ROTL64(a[4] ^ d[4], 27);
+    b[16] = ROTL64(a[5] ^ d[0], 36);
+    b[1] = ROTL64(a[6] ^ d[1], 44);
+    b[11] = ROTL64(a[7] ^ d[2], 6);
+    b[21] = ROTL64(a[8] ^ d[3], 55);
+    b[6] = ROTL64(a[9] ^ d[4], 20);
+    b[7] = ROTL64(a[10] ^ d[0], 3);
+    b[17] = ROTL64(a[11] ^ d[1], 10);
+    b[2] = ROTL64(a[12] ^ d[2], 43);
+    b[12] = ROTL64(a[13] ^ d[3], 25);
+    b[22] = ROTL64(a[14] ^ d[4], 39);
+    b[23] = ROTL64(a[15] ^ d[0], 41);
+    b[8] = ROTL64(a[16] ^ d[1], 45);
+    b[18] = ROTL64(a[17] ^ d[2], 15);
+    b[3] = ROTL64(a[18] ^ d[3], 21);
+    b[13] = ROTL64(a[19] ^ d[4], 8);
+    b[14] = ROTL64(a[20] ^ d[0], 18);
+    b[24] = ROTL64(a[21] ^ d[1], 2);
+    b[9] = ROTL64(a[22] ^ d[2], 61);
+    b[19] = ROTL64(a[23] ^ d[3], 56);
+    b[4] = ROTL64(a[24] ^ d[4], 14);
+
+    // Chi
+    a[0] = b[0] ^ (~b[1] & b[2]);
+    a[1] = b[1] ^ (~b[2] & b[3]);
+    a[2] = b[2] ^ (~b[3] & b[4]);
+    a[3] = b[3] ^ (~b[4] & b[0]);
+    a[4] = b[4] ^ (~b[0] & b[1]);
+    a[5] = b[5] ^ (~b[6] & b[7]);
+    a[6] = b[6] ^ (~b[7] & b[8]);
+    a[7] = b[7] ^ (~b[8] & b[9]);
+    a[8] = b[8] ^ (~b[9] & b[5]);
+    a[9] = b[9] ^ (~b[5] & b[6]);
+    a[10] = b[10] ^ (~b[11] & b[12]);
+    a[11] = b[11] ^ (~b[12] & b[13]);
+    a[12] = b[12] ^ (~b[13] & b[14]);
+    a[13] = b[13] ^ (~b[14] & b[10]);
+    a[14] = b[14] ^ (~b[10] & b[11]);
+    a[15] = b[15] ^ (~b[16] & b[17]);
+    a[16] = b[16] ^ (~b[17] & b[18]);
+    a[17] = b[17] ^ (~b[18] & b[19]);
+    a[18] = b[18] ^ (~b[19] & b[15]);
+    a[19] = b[19] ^ (~b[15] & b[16]);
+    a[20] = b[20] ^ (~b[21] & b[22]);
+    a[21] = b[21] ^ (~b[22] & b[23]);
+    a[22] = b[22] ^ (~b[23] & b[24]);
+    a[23] = b[23] ^ (~b[24] & b[20]);
+    a[24] = b[24] ^ (~b[20] & b[21]);
 
-    //  Chi
-    for (j = 0; j < 25; j += 5) 
-    {
-      for (i = 0; i < 5; i++)
-  bc[i] = st[j + i];
-      for (i = 0; i < 5; i++)
-  st[j + i] ^= (~bc[(i + 1) % 5]) & bc[(i + 2) % 5];
-    }
-
-    //printf("After Chi:\n");
-    //printState(st);
     //  Iota
-    st[0] ^= sha3_t::keccakf_rndc[round_num];
-    //printf("After Round %d:\n",round_num);
-    //printState(st);
+    a[0] ^= sha3_t::keccakf_rndc[round_num];
   }
+
+  memcpy(st, a, sizeof(a));
 }
 
 void sha3_t::sha3_init(sha3_state *sctx)
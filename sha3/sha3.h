@@ -46,26 +46,20 @@ public:
         msg_addr = xs1;
         hash_addr = xs2;
         break;
-      case 1: // setup msg length and run
+      case 1: { // setup msg length and run
         msg_len = xs1;
 
         //read message into buffer
-        unsigned char* input;
-        input  = (unsigned char*)malloc(msg_len*sizeof(char));
-        for(uint32_t i = 0; i < msg_len; i++)
-          input[i] = p->get_mmu()->load_uint8(msg_addr + i);
-          
+        std::vector<unsigned char> input(msg_len);
+        p->get_mmu()->load_bytes(msg_addr, msg_len, input.data());
+
         unsigned char output[SHA3_256_DIGEST_SIZE];
-        sha3ONE(input, msg_len, output);
+        sha3ONE(input.data(), msg_len, output);
 
         //write output
-        for(uint32_t i = 0; i < SHA3_256_DIGEST_SIZE; i++)
-          p->get_mmu()->store_uint8(hash_addr + i, output[i]);
-        
-        //clean up
-        free(input);
-
+        p->get_mmu()->store_bytes(hash_addr, SHA3_256_DIGEST_SIZE, output);
         break;
+      }
 
       case 2: // sfence
         break;
@@ -112,20 +106,6 @@ static constexpr uint64_t keccakf_rndc[24] =
     0x8000000000008080, 0x0000000080000001, 0x8000000080008008
   };
 
-static constexpr int keccakf_rotc[24] = 
-  {
-    1,  3,  6,  10, 15, 21, 28, 36, 45, 55, 2,  14, 
-    27, 41, 56, 8,  25, 43, 62, 18, 39, 61, 20, 44
-  };
-
-static constexpr int keccakf_piln[24] = 
-  {
-    10, 7,  11, 17, 18, 3, 5,  16, 8,  21, 24, 4, 
-    15, 23, 19, 13, 12, 2, 20, 14, 22, 9,  6,  1 
-  };
-
-void printState(uint64_t st[25]);
-
 // update the state with given number of rounds
 void keccakf(uint64_t st[25], int rounds);
 
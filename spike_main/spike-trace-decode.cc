@@ -0,0 +1,33 @@
+// See LICENSE for license details.
+
+// This little program converts a binary commit trace written with
+//   spike --commit-trace=<file>
+// back into the text format of --log-commits.
+
+#include <stdio.h>
+#include <stdexcept>
+#include "commit_trace.h"
+
+int main(int argc, char** argv)
+{
+  if (argc > 2) {
+    fprintf(stderr, "usage: %s [trace file]\n", argv[0]);
+    return 1;
+  }
+
+  FILE* in = stdin;
+  if (argc == 2 && !(in = fopen(argv[1], "rb"))) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  try {
+    commit_trace_decode(in, stdout);
+  } catch (std::runtime_error& e) {
+    fflush(stdout);
+    fprintf(stderr, "%s: %s\n", argc == 2 ? argv[1] : "stdin", e.what());
+    return 1;
+  }
+
+  return 0;
+}
@@ -6,6 +6,8 @@
 #include "cachesim.h"
 #include "extension.h"
 #include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <fesvr/option_parser.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -33,15 +35,25 @@ static void help(int exit_code = 1)
   fprintf(stderr, "  -h, --help            Print this help message\n");
   fprintf(stderr, "  -H                    Start halted, allowing a debugger to connect\n");
   fprintf(stderr, "  --log=<name>          File name for option -l\n");
+  fprintf(stderr, "  --commit-trace=<name> Log commits to a compact binary trace file\n");
+  fprintf(stderr, "                          (convert it to text with spike-trace-decode)\n");
   fprintf(stderr, "  --debug-cmd=<name>    Read commands from file (use with -d)\n");
   fprintf(stderr, "  --isa=<name>          RISC-V ISA string [default %s]\n", DEFAULT_ISA);
   fprintf(stderr, "  --priv=<m|mu|msu>     RISC-V privilege modes supported [default %s]\n", DEFAULT_PRIV);
   fprintf(stderr, "  --varch=<name>        RISC-V Vector uArch string [default %s]\n", DEFAULT_VARCH);
   fprintf(stderr, "  --pc=<address>        Override ELF entry point\n");
   fprintf(stderr, "  --hartids=<a,b,...>   Explicitly specify hartids, default is 0,1,...\n");
+  fprintf(stderr, "  --threads=<n>         Run the processors on up to <n> host threads [default 1]\n");
   fprintf(stderr, "  --ic=<S>:<W>:<B>      Instantiate a cache model with S sets,\n");
   fprintf(stderr, "  --dc=<S>:<W>:<B>        W ways, and B-byte blocks (with S and\n");
-  fprintf(stderr, "  --l2=<S>:<W>:<B>        B both powers of 2).\n");
+  fprintf(stderr, "  --l2=<S>:<W>:<B>        B both powers of 2).  Append :lru or :plru\n");
+  fprintf(stderr, "                          to replace LRU or pseudo-LRU rather than at\n");
+  fprintf(stderr, "                          random.  Each hart gets its own I$ and D$.\n");
+  fprintf(stderr, "  --tlb=<S>:<W>         Use a TLB with S sets (a power of 2) and W ways [default 256:4]\n");
+  fprintf(stderr, "  --tlb-stats           Print TLB hit/miss statistics on exit\n");
+  fprintf(stderr, "  --checkpoint=<n>:<file>  Save a checkpoint to <file> once hart 0 has\n");
+  fprintf(stderr, "                          retired <n> instructions\n");
+  fprintf(stderr, "  --restore=<file>      Start from a checkpoint saved by --checkpoint\n");
   fprintf(stderr, "  --device=<P,B,A>      Attach MMIO plugin device from an --extlib library\n");
   fprintf(stderr, "                          P -- Name of the MMIO plugin\n");
   fprintf(stderr, "                          B -- Base memory address of the device\n");
@@ -97,6 +109,14 @@ static std::ifstream::pos_type get_file_size(const char *filename)
 static void read_file_bytes(const char *filename,size_t fileoff,
                             mem_t* mem, size_t memoff, size_t read_sz)
 {
+  int fd = open(filename, O_RDONLY);
+  if (fd != -1) {
+    bool loaded = mem->load_file(memoff, read_sz, fd, fileoff);
+    close(fd);
+    if (loaded)
+      return;
+  }
+
   std::ifstream in(filename, std::ios::in | std::ios::binary);
   in.seekg(fileoff, std::ios::beg);
 
@@ -218,6 +238,7 @@ int main(int argc, char** argv)
   bool dtb_enabled = true;
   bool real_time_clint = false;
   size_t nprocs = 1;
+  size_t nthreads = 1;
   const char* kernel = NULL;
   reg_t kernel_offset, kernel_size;
   size_t initrd_size;
@@ -226,12 +247,21 @@ int main(int argc, char** argv)
   reg_t start_pc = reg_t(-1);
   std::vector<std::pair<reg_t, mem_t*>> mems;
   std::vector<std::pair<reg_t, abstract_device_t*>> plugin_devices;
-  std::unique_ptr<icache_sim_t> ic;
-  std::unique_ptr<dcache_sim_t> dc;
+  const char* ic_config = NULL;
+  const char* dc_config = NULL;
+  std::vector<std::unique_ptr<icache_sim_t>> ic;
+  std::vector<std::unique_ptr<dcache_sim_t>> dc;
   std::unique_ptr<cache_sim_t> l2;
+  std::unique_ptr<cache_sim_thread_t> cache_thread;
   bool log_cache = false;
+  size_t tlb_sets = 0, tlb_ways = 0;
+  bool tlb_stats = false;
+  reg_t checkpoint_insns = 0;
+  std::string checkpoint_path;
+  const char* restore_path = NULL;
   bool log_commits = false;
   const char *log_path = nullptr;
+  const char *commit_trace_path = nullptr;
   std::vector<std::function<extension_t*()>> extensions;
   const char* initrd = NULL;
   const char* isa = DEFAULT_ISA;
@@ -318,15 +348,31 @@ int main(int argc, char** argv)
   parser.option('s', 0, 0, [&](const char* s){socket = true;});
 #endif
   parser.option('p', 0, 1, [&](const char* s){nprocs = atoul_nonzero_safe(s);});
+  parser.option(0, "threads", 1, [&](const char* s){nthreads = atoul_nonzero_safe(s);});
   parser.option('m', 0, 1, [&](const char* s){mems = make_mems(s);});
   // I wanted to use --halted, but for some reason that doesn't work.
   parser.option('H', 0, 0, [&](const char* s){halted = true;});
   parser.option(0, "rbb-port", 1, [&](const char* s){use_rbb = true; rbb_port = atoul_safe(s);});
   parser.option(0, "pc", 1, [&](const char* s){start_pc = strtoull(s, 0, 0);});
   parser.option(0, "hartids", 1, hartids_parser);
-  parser.option(0, "ic", 1, [&](const char* s){ic.reset(new icache_sim_t(s));});
-  parser.option(0, "dc", 1, [&](const char* s){dc.reset(new dcache_sim_t(s));});
+  parser.option(0, "ic", 1, [&](const char* s){ic_config = s;});
+  parser.option(0, "dc", 1, [&](const char* s){dc_config = s;});
   parser.option(0, "l2", 1, [&](const char* s){l2.reset(cache_sim_t::construct(s, "L2$"));});
+  parser.option(0, "tlb", 1, [&](const char* s){
+    const char* wp = strchr(s, ':');
+    if (!wp++) help();
+    tlb_sets = atoul_nonzero_safe(std::string(s, wp - 1).c_str());
+    tlb_ways = atoul_nonzero_safe(wp);
+    if (tlb_sets & (tlb_sets - 1)) help();
+  });
+  parser.option(0, "tlb-stats", 0, [&](const char* s){tlb_stats = true;});
+  parser.option(0, "checkpoint", 1, [&](const char* s){
+    const char* fp = strchr(s, ':');
+    if (!fp++ || !*fp) help();
+    checkpoint_insns = strtoull(std::string(s, fp - 1).c_str(), 0, 0);
+    checkpoint_path = fp;
+  });
+  parser.option(0, "restore", 1, [&](const char* s){restore_path = s;});
   parser.option(0, "log-cache-miss", 0, [&](const char* s){log_cache = true;});
   parser.option(0, "isa", 1, [&](const char* s){isa = s;});
   parser.option(0, "priv", 1, [&](const char* s){priv = s;});
@@ -367,6 +413,8 @@ int main(int argc, char** argv)
       [&](const char* s){dm_config.support_haltgroups = false;});
   parser.option(0, "log-commits", 0,
                 [&](const char* s){log_commits = true;});
+  parser.option(0, "commit-trace", 1,
+                [&](const char* s){log_commits = true; commit_trace_path = s;});
   parser.option(0, "log", 1,
                 [&](const char* s){log_path = s;});
   FILE *cmd_file = NULL;
@@ -385,6 +433,13 @@ int main(int argc, char** argv)
   if (!*argv1)
     help();
 
+  if (nthreads > 1 && (debug || halted || log || log_commits || histogram ||
+                       use_rbb)) {
+    fprintf(stderr, "--threads can't be combined with debugging, logging, "
+            "or histograms\n");
+    exit(1);
+  }
+
   if (kernel && check_file_exists(kernel)) {
     kernel_size = get_file_size(kernel);
     if (isa[2] == '6' && isa[3] == '4')
@@ -454,14 +509,36 @@ int main(int argc, char** argv)
     return 0;
   }
 
-  if (ic && l2) ic->set_miss_handler(&*l2);
-  if (dc && l2) dc->set_miss_handler(&*l2);
-  if (ic) ic->set_log(log_cache);
-  if (dc) dc->set_log(log_cache);
+  // Each hart gets its own L1s, sharing the L2; the D$s are kept coherent.
+  // The models run on their own thread, fed in batches.
+  if (ic_config || dc_config)
+    cache_thread.reset(new cache_sim_thread_t);
+  for (size_t i = 0; i < nprocs && (ic_config || dc_config); i++)
+  {
+    std::string prefix = nprocs > 1 ? "C" + std::to_string(i) + " " : "";
+    if (ic_config) {
+      ic.emplace_back(new icache_sim_t(ic_config, (prefix + "I$").c_str()));
+      if (l2) ic.back()->set_miss_handler(&*l2);
+      ic.back()->set_log(log_cache);
+      ic.back()->set_thread(&*cache_thread);
+    }
+    if (dc_config) {
+      dc.emplace_back(new dcache_sim_t(dc_config, (prefix + "D$").c_str()));
+      if (l2) dc.back()->set_miss_handler(&*l2);
+      dc.back()->set_log(log_cache);
+      dc.back()->set_thread(&*cache_thread);
+    }
+  }
+  for (auto& a : dc)
+    for (auto& b : dc)
+      if (a != b)
+        a->get_cache()->add_peer(b->get_cache());
+
   for (size_t i = 0; i < nprocs; i++)
   {
-    if (ic) s.get_core(i)->get_mmu()->register_memtracer(&*ic);
-    if (dc) s.get_core(i)->get_mmu()->register_memtracer(&*dc);
+    if (tlb_sets) s.get_core(i)->get_mmu()->configure_tlb(tlb_sets, tlb_ways);
+    if (!ic.empty()) s.get_core(i)->get_mmu()->register_memtracer(&*ic[i]);
+    if (!dc.empty()) s.get_core(i)->get_mmu()->register_memtracer(&*dc[i]);
     for (auto e : extensions) {
       s.get_core(i)->register_extension(e());
       s.get_core(i)->reset();
@@ -469,11 +546,23 @@ int main(int argc, char** argv)
   }
 
   s.set_debug(debug);
-  s.configure_log(log, log_commits);
+  s.configure_log(log, log_commits, commit_trace_path);
   s.set_histogram(histogram);
+  s.set_threads(nthreads);
+  if (!checkpoint_path.empty())
+    s.set_checkpoint(checkpoint_insns, checkpoint_path.c_str());
+  if (restore_path)
+    s.set_restore(restore_path);
+  if (tlb_stats)
+    for (size_t i = 0; i < nprocs; i++)
+      s.get_core(i)->get_mmu()->set_tlb_stats(true);
 
   auto return_code = s.run();
 
+  if (tlb_stats)
+    for (size_t i = 0; i < nprocs; i++)
+      s.get_core(i)->get_mmu()->print_tlb_stats();
+
   for (auto& mem : mems)
     delete mem.second;
 
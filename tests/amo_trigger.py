@@ -0,0 +1,25 @@
+#!/usr/bin/python
+
+import subprocess
+import testlib
+import unittest
+
+class AmoTriggerTest(unittest.TestCase):
+    def setUp(self):
+        self.binary = testlib.compile("amo_trigger.S", "-nostdlib",
+                "-nostartfiles", "-T", "bench.ld")
+
+    def run_spike(self, *args):
+        return subprocess.call([testlib.find_file("spike"), "-p2"] +
+                list(args) + [self.binary])
+
+    def test_amo_trigger(self):
+        """AMOs and store-conditionals hit armed store triggers."""
+        self.assertEqual(self.run_spike(), 0)
+
+    def test_amo_trigger_threads(self):
+        """...also when the harts run on their own host threads."""
+        self.assertEqual(self.run_spike("--threads=2"), 0)
+
+if __name__ == '__main__':
+    unittest.main()
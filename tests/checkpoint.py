@@ -0,0 +1,74 @@
+#!/usr/bin/python
+
+import errno
+import os
+import subprocess
+import tempfile
+import testlib
+import unittest
+
+class CheckpointTest(unittest.TestCase):
+    def setUp(self):
+        self.binary = testlib.compile("checkpoint.S", "-nostdlib",
+                "-nostartfiles", "-T", "bench.ld")
+        self.spike = testlib.find_file("spike")
+        self.dir = tempfile.mkdtemp()
+        self.path = os.path.join(self.dir, "checkpoint")
+
+    def tearDown(self):
+        if os.path.exists(self.path):
+            os.unlink(self.path)
+        os.rmdir(self.dir)
+
+    def run_spike(self, *args):
+        process = subprocess.Popen([self.spike] + list(args) + [self.binary],
+                stderr=subprocess.PIPE)
+        stderr = process.communicate()[1]
+        return process.returncode, stderr.decode()
+
+    def test_restore(self):
+        """Restoring a checkpoint taken part-way through gives the same
+        result as running straight through."""
+        expected, _ = self.run_spike()
+        result, _ = self.run_spike("--checkpoint=500000:" + self.path)
+        self.assertEqual(result, expected)
+        self.assertTrue(os.path.exists(self.path))
+        result, _ = self.run_spike("--restore=" + self.path)
+        self.assertEqual(result, expected)
+
+    def test_checkpoint_over_restored_file(self):
+        """A restored run can save its next checkpoint over the file it
+        was restored from."""
+        expected, _ = self.run_spike()
+        self.run_spike("--checkpoint=300000:" + self.path)
+        result, _ = self.run_spike("--restore=" + self.path,
+                "--checkpoint=600000:" + self.path)
+        self.assertEqual(result, expected)
+        result, _ = self.run_spike("--restore=" + self.path)
+        self.assertEqual(result, expected)
+
+    def test_restore_bad_file(self):
+        """A file that isn't a checkpoint is rejected."""
+        with open(self.path, "w") as f:
+            f.write("not a checkpoint\n")
+        result, stderr = self.run_spike("--restore=" + self.path)
+        self.assertEqual(result, 1)
+        self.assertIn("not a checkpoint file", stderr)
+
+    def test_save_error(self):
+        """A checkpoint that can't be written reports why."""
+        path = os.path.join(self.dir, "missing", "checkpoint")
+        result, stderr = self.run_spike("--checkpoint=1000:" + path)
+        self.assertEqual(result, 1)
+        self.assertIn("can't write checkpoint", stderr)
+        self.assertIn(os.strerror(errno.ENOENT), stderr)
+
+    @unittest.skipUnless(os.path.exists("/dev/full"), "needs /dev/full")
+    def test_write_error(self):
+        """A failed write is reported as the cause, not the close after it."""
+        result, stderr = self.run_spike("--checkpoint=1000:/dev/full")
+        self.assertEqual(result, 1)
+        self.assertIn(os.strerror(errno.ENOSPC), stderr)
+
+if __name__ == '__main__':
+    unittest.main()
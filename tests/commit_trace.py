@@ -0,0 +1,72 @@
+#!/usr/bin/python
+
+import errno
+import os
+import subprocess
+import tempfile
+import testlib
+import unittest
+
+class CommitTraceTest(unittest.TestCase):
+    def setUp(self):
+        self.binary = testlib.compile("commit_trace.S", "-nostdlib",
+                "-nostartfiles", "-T", "bench.ld")
+        self.spike = testlib.find_file("spike")
+        self.dir = tempfile.mkdtemp()
+        process = subprocess.Popen([self.spike, "--log-commits",
+                "--log=" + os.devnull, self.binary], stderr=subprocess.PIPE)
+        if "--enable-commitlog" in process.communicate()[1].decode():
+            os.rmdir(self.dir)
+            self.skipTest("spike was built without --enable-commitlog")
+
+    def tearDown(self):
+        for name in os.listdir(self.dir):
+            os.unlink(os.path.join(self.dir, name))
+        os.rmdir(self.dir)
+
+    def test_decode(self):
+        """The decoded binary trace matches the text commit log."""
+        log = os.path.join(self.dir, "log")
+        trace = os.path.join(self.dir, "trace")
+        result = subprocess.call([self.spike, "--log-commits",
+                "--log=" + log, self.binary])
+        self.assertEqual(result, 0)
+        result = subprocess.call([self.spike, "--commit-trace=" + trace,
+                self.binary])
+        self.assertEqual(result, 0)
+
+        decoded = subprocess.check_output([
+            testlib.find_file("spike-trace-decode"), trace])
+        with open(log, "rb") as f:
+            expected = f.read()
+        self.assertGreater(len(expected), 0)
+        self.assertEqual(decoded, expected)
+        self.assertLess(os.path.getsize(trace), len(expected))
+
+    def test_decode_bad_file(self):
+        """A truncated trace is an error, not silently short output."""
+        trace = os.path.join(self.dir, "trace")
+        result = subprocess.call([self.spike, "--commit-trace=" + trace,
+                self.binary])
+        self.assertEqual(result, 0)
+        with open(trace, "rb") as f:
+            data = f.read()
+        with open(trace, "wb") as f:
+            f.write(data[:len(data) // 2])
+        with open(os.devnull, "w") as devnull:
+            result = subprocess.call([testlib.find_file("spike-trace-decode"),
+                    trace], stdout=devnull, stderr=devnull)
+        self.assertEqual(result, 1)
+
+    @unittest.skipUnless(os.path.exists("/dev/full"), "needs /dev/full")
+    def test_write_error(self):
+        """A trace that can't be written is reported, not left truncated
+        without a word."""
+        process = subprocess.Popen([self.spike, "--commit-trace=/dev/full",
+                self.binary], stderr=subprocess.PIPE)
+        stderr = process.communicate()[1].decode()
+        self.assertIn("can't write commit trace /dev/full: " +
+                os.strerror(errno.ENOSPC), stderr)
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,39 @@
+// See LICENSE for license details.
+
+// Measures how many host<->target context_t switches a second fesvr can
+// make, as sim_t does every INTERLEAVE instructions.
+
+#include "context.h"
+#include <chrono>
+#include <stdio.h>
+
+static const long ROUND_TRIPS = 2000000;
+
+static context_t* host;
+static context_t target;
+static long target_count;
+
+static void target_main(void*)
+{
+  while (true) {
+    target_count++;
+    host->switch_to();
+  }
+}
+
+int main()
+{
+  host = context_t::current();
+  target.init(target_main, NULL);
+
+  long start_count = target_count;
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < ROUND_TRIPS; i++)
+    target.switch_to();
+  auto end = std::chrono::steady_clock::now();
+
+  double secs = std::chrono::duration<double>(end - start).count();
+  printf("%ld round trips in %.3f s: %.1fM switches/s\n", ROUND_TRIPS, secs,
+         2 * ROUND_TRIPS / secs / 1e6);
+  return target_count - start_count != ROUND_TRIPS;
+}
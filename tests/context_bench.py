@@ -0,0 +1,13 @@
+#!/usr/bin/python
+
+import testlib
+import unittest
+
+class ContextBench(unittest.TestCase):
+    def test_switch_rate(self):
+        """Time host<->target context switches."""
+        self.assertEqual(testlib.run_host("context_bench.cc",
+                "../fesvr/context.cc", "-lpthread"), 0)
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,130 @@
+// See LICENSE for license details.
+
+// Times the rv64 aes64* and clmul* instruction bodies on the host's AES-NI
+// and PCLMULQDQ (host_crypto.h) against the table and bit-loop bodies they
+// replace, and checks that both give the same results.
+
+#include "processor.h"
+#include "arith.h"
+#include "host_crypto.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const bool have_aes = HOST_AES_SUPPORTED;
+static const bool have_clmul = HOST_CLMUL_SUPPORTED;
+
+#include "host_insn.h"
+
+#undef HOST_AES_SUPPORTED
+#undef HOST_CLMUL_SUPPORTED
+#define HOST_AES_SUPPORTED use_host
+#define HOST_CLMUL_SUPPORTED use_host
+
+typedef void (*crypto_func_t)(hart_t*, operands_t&, bool);
+
+#define xlen 64
+static void rv64_aes64es(hart_t* p, operands_t& op, bool use_host) {
+  #include "insns/aes64es.h"
+}
+static void rv64_aes64esm(hart_t* p, operands_t& op, bool use_host) {
+  #include "insns/aes64esm.h"
+}
+static void rv64_aes64ds(hart_t* p, operands_t& op, bool use_host) {
+  #include "insns/aes64ds.h"
+}
+static void rv64_aes64dsm(hart_t* p, operands_t& op, bool use_host) {
+  #include "insns/aes64dsm.h"
+}
+static void rv64_aes64im(hart_t* p, operands_t& op, bool use_host) {
+  #include "insns/aes64im.h"
+}
+static void rv64_clmul(hart_t* p, operands_t& op, bool use_host) {
+  #include "insns/clmul.h"
+}
+static void rv64_clmulh(hart_t* p, operands_t& op, bool use_host) {
+  #include "insns/clmulh.h"
+}
+static void rv64_clmulr(hart_t* p, operands_t& op, bool use_host) {
+  #include "insns/clmulr.h"
+}
+#undef xlen
+
+struct crypto_insn_t {
+  const char* name;
+  crypto_func_t func;
+  const bool& has_host;
+};
+
+static const crypto_insn_t insns[] = {
+  {"aes64es", rv64_aes64es, have_aes},
+  {"aes64esm", rv64_aes64esm, have_aes},
+  {"aes64ds", rv64_aes64ds, have_aes},
+  {"aes64dsm", rv64_aes64dsm, have_aes},
+  {"aes64im", rv64_aes64im, have_aes},
+  {"clmul", rv64_clmul, have_clmul},
+  {"clmulh", rv64_clmulh, have_clmul},
+  {"clmulr", rv64_clmulr, have_clmul},
+};
+
+static const long ITERATIONS = 2000000;
+
+static uint64_t next_random(uint64_t& state)
+{
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+// Run the body ITERATIONS times, feeding each result into the next operands
+// so the calls can't be overlapped or elided, and return ns per call.
+static double time_insn(const crypto_insn_t& insn, bool use_host, reg_t& last)
+{
+  hart_t hart;
+  operands_t op = {0x0123456789abcdef, 0xfedcba9876543210, 0};
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < ITERATIONS; i++) {
+    insn.func(&hart, op, use_host);
+    op.rs1 = op.rd ^ i;
+  }
+  auto end = std::chrono::steady_clock::now();
+  last = op.rd;
+  return std::chrono::duration<double, std::nano>(end - start).count() / ITERATIONS;
+}
+
+int main()
+{
+  unsigned long failures = 0;
+  uint64_t state = 0x9e3779b97f4a7c15;
+
+  printf("%-10s %12s %12s %8s\n", "insn", "table ns", "host ns", "speedup");
+  for (const crypto_insn_t& insn : insns) {
+    if (!insn.has_host) {
+      printf("%-10s (no host instruction)\n", insn.name);
+      continue;
+    }
+
+    for (int i = 0; i < 100000; i++) {
+      hart_t hart;
+      operands_t table = {next_random(state), next_random(state), 0};
+      operands_t host = table;
+      insn.func(&hart, table, false);
+      insn.func(&hart, host, true);
+      if (table.rd != host.rd && failures++ < 20)
+        fprintf(stderr, "%s: rs1=%016" PRIx64 " rs2=%016" PRIx64 " gave %016"
+                PRIx64 ", expected %016" PRIx64 "\n", insn.name, table.rs1,
+                table.rs2, host.rd, table.rd);
+    }
+
+    reg_t table_last, host_last;
+    double table_ns = time_insn(insn, false, table_last);
+    double host_ns = time_insn(insn, true, host_last);
+    if (table_last != host_last)
+      failures++;
+    printf("%-10s %12.2f %12.2f %7.1fx\n", insn.name, table_ns, host_ns,
+           table_ns / host_ns);
+  }
+
+  return failures != 0;
+}
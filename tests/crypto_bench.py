@@ -0,0 +1,13 @@
+#!/usr/bin/python
+
+import testlib
+import unittest
+
+class CryptoBench(unittest.TestCase):
+    def test_host_crypto(self):
+        """Time the aes64* and clmul* bodies on the host's AES-NI and
+        PCLMULQDQ against the table paths, which they must match."""
+        self.assertEqual(testlib.run_host("crypto_bench.cc"), 0)
+
+if __name__ == '__main__':
+    unittest.main()
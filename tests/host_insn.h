@@ -0,0 +1,32 @@
+// See LICENSE for license details.
+
+#ifndef _TESTS_HOST_INSN_H
+#define _TESTS_HOST_INSN_H
+
+// Lets a host program include instruction bodies from riscv/insns, the way
+// insn_template.cc does, without a simulator around them: each body becomes
+// a function of a hart_t* p and an operands_t& op.  Include it after
+// processor.h and any host_*.h headers the bodies use.
+
+// Just enough of a hart to run the instruction bodies.
+struct hart_t {
+  struct { reg_t vxsat; } VU;
+  bool extension_enabled(int) { return true; }
+};
+
+struct operands_t {
+  reg_t rs1, rs2, rd;
+};
+
+#undef RS1
+#undef RS2
+#undef RD
+#undef WRITE_RD
+#undef require
+#define RS1 op.rs1
+#define RS2 op.rs2
+#define RD op.rd
+#define WRITE_RD(value) op.rd = (value)
+#define require(x) do { if (!(x)) abort(); } while (0)
+
+#endif
@@ -0,0 +1,16 @@
+#!/usr/bin/python
+
+import subprocess
+import testlib
+import unittest
+
+class MprvTest(unittest.TestCase):
+    def test_mprv(self):
+        """M-mode loads translate as MPP while MPRV is set, and only then."""
+        binary = testlib.compile("mprv.S", "-nostdlib", "-nostartfiles",
+                "-T", "bench.ld")
+        self.assertEqual(subprocess.call([testlib.find_file("spike"),
+                binary]), 0)
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,291 @@
+// See LICENSE for license details.
+
+// Checks the host SIMD kernels behind kadd8/16, ksub8/16, ukadd8/16,
+// uksub8/16, khm8/16 and khmx8/16 (host_simd.h) bit for bit against the
+// scalar P_LOOP bodies of the same instructions, and both against lanes
+// taken apart with get_field/set_field.  8-bit lanes are checked for every
+// pair of inputs, 16- and 32-bit lanes for every pair of boundary values.
+
+#include "processor.h"
+#include "arith.h"
+#include "host_simd.h"
+#include <limits>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const bool host_simd = HOST_SIMD_SUPPORTED;
+
+#include "host_insn.h"
+
+#undef HOST_SIMD_SUPPORTED
+#define HOST_SIMD_SUPPORTED use_simd
+
+typedef void (*p_insn_func_t)(hart_t*, operands_t&, bool);
+
+#define xlen 32
+static void rv32_kadd8(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/kadd8.h"
+}
+static void rv32_kadd16(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/kadd16.h"
+}
+static void rv32_ksub8(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/ksub8.h"
+}
+static void rv32_ksub16(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/ksub16.h"
+}
+static void rv32_ukadd8(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/ukadd8.h"
+}
+static void rv32_ukadd16(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/ukadd16.h"
+}
+static void rv32_uksub8(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/uksub8.h"
+}
+static void rv32_uksub16(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/uksub16.h"
+}
+static void rv32_khm8(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/khm8.h"
+}
+static void rv32_khm16(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/khm16.h"
+}
+static void rv32_khmx8(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/khmx8.h"
+}
+static void rv32_khmx16(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/khmx16.h"
+}
+#undef xlen
+
+#define xlen 64
+static void rv64_kadd8(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/kadd8.h"
+}
+static void rv64_kadd16(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/kadd16.h"
+}
+static void rv64_kadd32(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/kadd32.h"
+}
+static void rv64_ksub8(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/ksub8.h"
+}
+static void rv64_ksub16(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/ksub16.h"
+}
+static void rv64_ksub32(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/ksub32.h"
+}
+static void rv64_ukadd8(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/ukadd8.h"
+}
+static void rv64_ukadd16(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/ukadd16.h"
+}
+static void rv64_ukadd32(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/ukadd32.h"
+}
+static void rv64_uksub8(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/uksub8.h"
+}
+static void rv64_uksub16(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/uksub16.h"
+}
+static void rv64_uksub32(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/uksub32.h"
+}
+static void rv64_khm8(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/khm8.h"
+}
+static void rv64_khm16(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/khm16.h"
+}
+static void rv64_khmx8(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/khmx8.h"
+}
+static void rv64_khmx16(hart_t* p, operands_t& op, bool use_simd) {
+  #include "insns/khmx16.h"
+}
+#undef xlen
+
+enum sat_op_t { KADD, KSUB, UKADD, UKSUB, KHM };
+
+// A Q-format multiply: (a * b) >> (bits - 1), saturating the one case that
+// overflows.
+template<typename T, typename UT>
+static UT sat_qmul(UT a, UT b, bool& sat)
+{
+  if (T(a) == std::numeric_limits<T>::min() && T(b) == std::numeric_limits<T>::min()) {
+    sat = true;
+    return std::numeric_limits<T>::max();
+  }
+  return UT((int32_t(T(a)) * T(b)) >> (sizeof(T) * 8 - 1));
+}
+
+// One lane of the instruction, on the lane's raw bits.
+static reg_t ref_lane(sat_op_t op, int bits, reg_t a, reg_t b, bool& sat)
+{
+  switch (bits * 8 + op) {
+    case 8*8 + KADD: return (uint8_t)sat_add<int8_t, uint8_t>(a, b, sat);
+    case 8*8 + KSUB: return (uint8_t)sat_sub<int8_t, uint8_t>(a, b, sat);
+    case 8*8 + UKADD: return sat_addu<uint8_t>(a, b, sat);
+    case 8*8 + UKSUB: return sat_subu<uint8_t>(a, b, sat);
+    case 8*8 + KHM: return sat_qmul<int8_t, uint8_t>(a, b, sat);
+    case 16*8 + KADD: return (uint16_t)sat_add<int16_t, uint16_t>(a, b, sat);
+    case 16*8 + KSUB: return (uint16_t)sat_sub<int16_t, uint16_t>(a, b, sat);
+    case 16*8 + UKADD: return sat_addu<uint16_t>(a, b, sat);
+    case 16*8 + UKSUB: return sat_subu<uint16_t>(a, b, sat);
+    case 16*8 + KHM: return sat_qmul<int16_t, uint16_t>(a, b, sat);
+    case 32*8 + KADD: return (uint32_t)sat_add<int32_t, uint32_t>(a, b, sat);
+    case 32*8 + KSUB: return (uint32_t)sat_sub<int32_t, uint32_t>(a, b, sat);
+    case 32*8 + UKADD: return sat_addu<uint32_t>(a, b, sat);
+    case 32*8 + UKSUB: return sat_subu<uint32_t>(a, b, sat);
+  }
+  abort();
+}
+
+struct p_insn_t {
+  const char* name;
+  p_insn_func_t func;
+  int xlen_;
+  int bits;
+  sat_op_t op;
+  bool cross; // rs1 lane i meets rs2 lane i ^ 1
+  bool has_simd;
+};
+
+static const p_insn_t insns[] = {
+  {"kadd8", rv32_kadd8, 32, 8, KADD, false, true},
+  {"kadd16", rv32_kadd16, 32, 16, KADD, false, true},
+  {"ksub8", rv32_ksub8, 32, 8, KSUB, false, true},
+  {"ksub16", rv32_ksub16, 32, 16, KSUB, false, true},
+  {"ukadd8", rv32_ukadd8, 32, 8, UKADD, false, true},
+  {"ukadd16", rv32_ukadd16, 32, 16, UKADD, false, true},
+  {"uksub8", rv32_uksub8, 32, 8, UKSUB, false, true},
+  {"uksub16", rv32_uksub16, 32, 16, UKSUB, false, true},
+  {"khm8", rv32_khm8, 32, 8, KHM, false, true},
+  {"khm16", rv32_khm16, 32, 16, KHM, false, true},
+  {"khmx8", rv32_khmx8, 32, 8, KHM, true, true},
+  {"khmx16", rv32_khmx16, 32, 16, KHM, true, true},
+  {"kadd8", rv64_kadd8, 64, 8, KADD, false, true},
+  {"kadd16", rv64_kadd16, 64, 16, KADD, false, true},
+  {"kadd32", rv64_kadd32, 64, 32, KADD, false, false},
+  {"ksub8", rv64_ksub8, 64, 8, KSUB, false, true},
+  {"ksub16", rv64_ksub16, 64, 16, KSUB, false, true},
+  {"ksub32", rv64_ksub32, 64, 32, KSUB, false, false},
+  {"ukadd8", rv64_ukadd8, 64, 8, UKADD, false, true},
+  {"ukadd16", rv64_ukadd16, 64, 16, UKADD, false, true},
+  {"ukadd32", rv64_ukadd32, 64, 32, UKADD, false, false},
+  {"uksub8", rv64_uksub8, 64, 8, UKSUB, false, true},
+  {"uksub16", rv64_uksub16, 64, 16, UKSUB, false, true},
+  {"uksub32", rv64_uksub32, 64, 32, UKSUB, false, false},
+  {"khm8", rv64_khm8, 64, 8, KHM, false, true},
+  {"khm16", rv64_khm16, 64, 16, KHM, false, true},
+  {"khmx8", rv64_khmx8, 64, 8, KHM, true, true},
+  {"khmx16", rv64_khmx16, 64, 16, KHM, true, true},
+};
+
+static unsigned long checks, failures;
+
+static reg_t sext_to(int xlen_, reg_t x)
+{
+  return xlen_ == 32 ? (reg_t)(int64_t)(int32_t)x : x;
+}
+
+static void check(const p_insn_t& insn, reg_t rs1, reg_t rs2)
+{
+  rs1 = sext_to(insn.xlen_, rs1);
+  rs2 = sext_to(insn.xlen_, rs2);
+
+  bool ref_sat = false;
+  reg_t ref = 0;
+  for (int i = 0; i < insn.xlen_ / insn.bits; i++) {
+    reg_t mask = make_mask64(i * insn.bits, insn.bits);
+    reg_t mask2 = make_mask64((insn.cross ? i ^ 1 : i) * insn.bits, insn.bits);
+    bool sat = false;
+    ref = set_field(ref, mask, ref_lane(insn.op, insn.bits, get_field(rs1, mask),
+                                        get_field(rs2, mask2), sat));
+    ref_sat |= sat;
+  }
+  ref = sext_to(insn.xlen_, ref);
+
+  for (int use_simd = 0; use_simd <= (insn.has_simd && host_simd); use_simd++) {
+    hart_t hart = {};
+    operands_t op = {rs1, rs2, 0x5a5a5a5a5a5a5a5a};
+    insn.func(&hart, op, use_simd);
+    checks++;
+    if (op.rd != ref || hart.VU.vxsat != ref_sat) {
+      if (failures++ < 20)
+        fprintf(stderr, "rv%d %s (%s): rs1=%016" PRIx64 " rs2=%016" PRIx64
+                " gave %016" PRIx64 "/%d, expected %016" PRIx64 "/%d\n",
+                insn.xlen_, insn.name, use_simd ? "simd" : "scalar", rs1, rs2,
+                op.rd, (int)hart.VU.vxsat, ref, (int)ref_sat);
+    }
+  }
+}
+
+// Place the pair (a, b) in the lanes one result reads, with zeros, which
+// never saturate, in the others.
+static void check_lane(const p_insn_t& insn, int lane, reg_t a, reg_t b)
+{
+  int lane2 = insn.cross ? lane ^ 1 : lane;
+  check(insn, a << (lane * insn.bits), b << (lane2 * insn.bits));
+}
+
+static const reg_t boundary16[] = {
+  0x0000, 0x0001, 0x0002, 0x3fff, 0x4000, 0x7ffe, 0x7fff,
+  0x8000, 0x8001, 0xbfff, 0xc000, 0xfffe, 0xffff,
+};
+
+static const reg_t boundary32[] = {
+  0x00000000, 0x00000001, 0x00000002, 0x3fffffff, 0x40000000, 0x7ffffffe,
+  0x7fffffff, 0x80000000, 0x80000001, 0xbfffffff, 0xc0000000, 0xfffffffe,
+  0xffffffff, 0x0000ffff, 0x00010000, 0xffff0000,
+};
+
+int main()
+{
+  for (const p_insn_t& insn : insns) {
+    int lanes = insn.xlen_ / insn.bits;
+    reg_t lane_mask = make_mask64(0, insn.bits);
+
+    if (insn.bits == 8) {
+      for (reg_t a = 0; a < 256; a++) {
+        for (reg_t b = 0; b < 256; b++) {
+          check_lane(insn, (a + b) % lanes, a, b);
+          // all lanes busy, with a different pair in each
+          reg_t rs1 = 0, rs2 = 0;
+          for (int i = 0; i < lanes; i++) {
+            rs1 |= ((a + 37 * i) & lane_mask) << (i * 8);
+            rs2 |= ((b + 91 * i) & lane_mask) << (i * 8);
+          }
+          check(insn, rs1, rs2);
+        }
+      }
+    } else {
+      const reg_t* values = insn.bits == 16 ? boundary16 : boundary32;
+      size_t n = insn.bits == 16 ? sizeof(boundary16) / sizeof(*boundary16)
+                                 : sizeof(boundary32) / sizeof(*boundary32);
+      for (size_t x = 0; x < n; x++) {
+        for (size_t y = 0; y < n; y++) {
+          for (int lane = 0; lane < lanes; lane++)
+            check_lane(insn, lane, values[x], values[y]);
+          reg_t rs1 = 0, rs2 = 0;
+          for (int i = 0; i < lanes; i++) {
+            rs1 |= values[(x + i) % n] << (i * insn.bits);
+            rs2 |= values[(y + 3 * i) % n] << (i * insn.bits);
+          }
+          check(insn, rs1, rs2);
+        }
+      }
+    }
+  }
+
+  printf("%lu checks, %lu failures%s\n", checks, failures,
+         host_simd ? "" : " (no host SIMD kernels)");
+  return failures != 0;
+}
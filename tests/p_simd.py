@@ -0,0 +1,13 @@
+#!/usr/bin/python
+
+import testlib
+import unittest
+
+class PSimdTest(unittest.TestCase):
+    def test_sat_add_sub(self):
+        """Make sure the host SIMD saturating add/sub/multiply kernels match
+        the scalar P_LOOP bodies, including vxsat."""
+        self.assertEqual(testlib.run_host("p_simd.cc"), 0)
+
+if __name__ == '__main__':
+    unittest.main()
@@ -31,6 +31,31 @@ def compile(*args):
     assert result == 0, "%r failed" % cmd
     return dst
 
+def compile_host(*args):
+    """Compile .cc files into a host binary against spike's headers. Run from
+    the build directory, which holds config.h."""
+    dst = os.path.splitext(args[0])[0]
+    top = os.path.dirname(os.path.dirname(os.path.abspath(testlib.__file__)))
+    cxx = os.environ.get("CXX", "g++")
+    cmd = [cxx, "-O2", "-std=c++11", "-o", dst, "-I."]
+    for directory in ("riscv", "fesvr", "softfloat", ""):
+        cmd.append("-I" + os.path.join(top, directory))
+    for arg in args:
+        found = find_file(arg)
+        if found:
+            cmd.append(found)
+        else:
+            cmd.append(arg)
+    cmd = " ".join(cmd)
+    result = os.system(cmd)
+    assert result == 0, "%r failed" % cmd
+    return os.path.abspath(dst)
+
+def run_host(*args):
+    """Compile a host program with compile_host, run it, and return its exit
+    status."""
+    return subprocess.call([compile_host(*args)])
+
 def unused_port():
     # http://stackoverflow.com/questions/2838244/get-open-tcp-port-in-python/2838309#2838309
     import socket
@@ -0,0 +1,31 @@
+#!/usr/bin/python
+
+import subprocess
+import testlib
+import time
+import unittest
+
+TRAPS = 3000000
+
+class TrapBench(unittest.TestCase):
+    def bench(self, source):
+        binary = testlib.compile(source, "-nostdlib", "-nostartfiles",
+                "-T", "bench.ld")
+        start = time.time()
+        result = subprocess.call([testlib.find_file("spike"), binary])
+        elapsed = time.time() - start
+        # The guest exits 1 if a trap had the wrong cause, pc or tval, or if
+        # it didn't take exactly TRAPS of them.
+        self.assertEqual(result, 0)
+        print("%s: %.2fs, %.0f traps/s" % (source, elapsed, TRAPS / elapsed))
+
+    def test_ecall(self):
+        """Time ecalls from S-mode into an M-mode handler."""
+        self.bench("ecall_bench.S")
+
+    def test_page_fault(self):
+        """Time load page faults from S-mode into an M-mode handler."""
+        self.bench("fault_bench.S")
+
+if __name__ == '__main__':
+    unittest.main()